@@ -0,0 +1,46 @@
+#include "comicinfo.h"
+#include <QDebug>
+#include <QXmlStreamReader>
+
+const QString ComicInfo::fileName = QStringLiteral("ComicInfo.xml");
+
+QHash<int, PageMetadata> ComicInfo::pageTable(const QByteArray& xml, int pageCount)
+{
+    QHash<int, PageMetadata> pages;
+    QXmlStreamReader reader(xml);
+    bool inPages = false;
+    while(!reader.atEnd())
+    {
+        const auto token = reader.readNext();
+        if(token == QXmlStreamReader::EndElement && reader.name() == QLatin1String("Pages")) break;
+        if(token != QXmlStreamReader::StartElement) continue;
+        if(reader.name() == QLatin1String("Pages"))
+        {
+            inPages = true;
+            continue;
+        }
+        if(!inPages || reader.name() != QLatin1String("Page")) continue;
+
+        const auto attributes = reader.attributes();
+        bool ok = false;
+        const int image = attributes.value("Image").toInt(&ok);
+        if(!ok || image < 0) continue;
+        if(image >= pageCount)
+        {
+            qDebug() << "ComicInfo.xml lists page" << image << "of" << pageCount << "pages, ignoring its page table";
+            return {};
+        }
+
+        PageMetadata meta;
+        meta.width = attributes.value("ImageWidth").toInt();
+        meta.height = attributes.value("ImageHeight").toInt();
+        if(meta.width <= 0 || meta.height <= 0) continue;
+        meta.fileSize = attributes.value("ImageSize").toInt();
+        meta.isBigPage = attributes.value("DoublePage").compare(QLatin1String("true"), Qt::CaseInsensitive) == 0;
+        if(const auto type = attributes.value("Type"); !type.isEmpty())
+            meta.tags.append(type.toString());
+        meta.valid = true;
+        pages.insert(image, meta);
+    }
+    return pages;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "metadata.h"
+#include <QByteArray>
+#include <QHash>
+
+/**
+ * The <Pages> table of a ComicInfo.xml, as written by ComicRack and most taggers.
+ * Each <Page Image="n"> may carry ImageWidth, ImageHeight, ImageSize, DoublePage and Type,
+ * which is everything the page layout needs without decoding a single page.
+ */
+class ComicInfo
+{
+public:
+    // name of the file at the root of the archive
+    static const QString fileName;
+    // metadata by page index for pages listing their dimensions, fileName and fileType are left to the caller.
+    // Tables that reference pages past pageCount don't belong to this archive and give nothing.
+    static QHash<int, PageMetadata> pageTable(const QByteArray& xml, int pageCount);
+};
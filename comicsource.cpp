@@ -17,16 +17,20 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "comicsource.h"
+#include "comicinfo.h"
+#include "naturalsort.h"
+#include "neighborindex.h"
 
 #include "mobicomicsource.h"
 #include "rarcomicsource.h"
 #include "pdfcomicsource.h"
 
 #include <QFileInfo>
-#include <QCollator>
 #include <QDebug>
 #include <QDir>
+#include <QDirIterator>
 #include <QImageReader>
+#include <QBuffer>
 #include <QMimeDatabase>
 #include <QTemporaryFile>
 #include <QCryptographicHash>
@@ -42,6 +46,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <quazip.h>
 #include <quazipfile.h>
 #include "imagecache.h"
+#include "grayscale.h"
+#include "encodedcache.h"
+#include "imagebufferpool.h"
 #include "mainwindow.h"
 #include <QDebug>
 #include <cstdio>
@@ -75,6 +82,22 @@ bool ComicSource::hasPagePixmap(int pageNum) const
     return !img.isNull();
 }
 
+QPixmap ComicSource::getPagePreview(int pageNum)
+{
+    return ThumbCache::cache().getPixmap({getID(), pageNum});
+}
+
+QSize ComicSource::getPageSize(int pageNum)
+{
+    auto img = ImageCache::cache().getImage({getID(), pageNum});
+    return img.isNull() ? QSize{} : img.size();
+}
+
+QPixmap ComicSource::getPagePixmapForSize(int pageNum, const QSize&)
+{
+    return getPagePixmap(pageNum);
+}
+
 DirectoryComicSource::DirectoryComicSource(const QString& path)
 {
     QFileInfo fInfo(path);
@@ -89,27 +112,43 @@ DirectoryComicSource::DirectoryComicSource(const QString& path)
 
     this->path = dir.absolutePath();
     qDebug()<<"directory, path is "<<this->path;
-    this->id = QString::fromUtf8(QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Md5).toHex());
 
-    dir.setFilter(QDir::Files | QDir::Hidden);
-    auto allFiles = dir.entryInfoList();
-    for(const auto& file: allFiles) {
-        if(fileSupported(file))
-            this->fileInfoList.append(file);
+
+    // classified by suffix without touching the files, only names without a suffix are sniffed
+    QStringList unclassified;
+    QDirIterator it(this->path, QDir::Files | QDir::Hidden);
+    while(it.hasNext())
+    {
+        it.next();
+        const QString name = it.fileName();
+        const int dot = name.lastIndexOf('.');
+        if(dot <= 0)
+            unclassified.append(name);
+        else if(imageSuffixes().contains(name.mid(dot + 1).toLower()))
+            this->fileInfoList.append(QFileInfo(it.filePath()));
+    }
+    for(const auto& name: std::as_const(unclassified))
+    {
+        const QString filePath = this->path + '/' + name;
+        if(!QImageReader::imageFormat(filePath).isEmpty())
+            this->fileInfoList.append(QFileInfo(filePath));
     }
 
-    QCollator collator;
-    collator.setNumericMode(true);
+    NaturalSort::sort(this->fileInfoList);
+
+    this->usedPageCount = this->fileInfoList.size();
 
-    std::sort(this->fileInfoList.begin(), this->fileInfoList.end(), [&collator](const QFileInfo& file1, const QFileInfo& file2) {
-        return collator.compare(file1.fileName(), file2.fileName()) < 0;
-    });
+    // the folder's modification time is part of the id, pages of a folder that changed since it was
+    // last opened are different cache entries. Pages appended later in place keep it.
+    const QString version = QString::number(QFileInfo(this->path).lastModified().toMSecsSinceEpoch());
+    this->id = QString::fromUtf8(QCryptographicHash::hash((this->path + '/' + version).toUtf8(), QCryptographicHash::Md5).toHex());
 
     if(!fInfo.isDir())
     {
+        const QString fileName = fInfo.fileName();
         for(int i = 0; i < this->fileInfoList.size(); i++)
         {
-            if(fInfo == this->fileInfoList[i])
+            if(fileName == this->fileInfoList[i].fileName())
             {
                 startPage = i+1;
                 break;
@@ -120,26 +159,61 @@ DirectoryComicSource::DirectoryComicSource(const QString& path)
 
 int DirectoryComicSource::getPageCount() const
 {
+    QReadLocker lock(&listLock);
     return this->fileInfoList.length();
 }
 
+QFileInfo DirectoryComicSource::pageFile(int pageNum) const
+{
+    QReadLocker lock(&listLock);
+    return this->fileInfoList.value(pageNum);
+}
+
+bool DirectoryComicSource::update(const DirectoryComicSource& newer)
+{
+    QWriteLocker lock(&listLock);
+    const auto& listing = newer.fileInfoList;
+    const int kept = std::min(listing.size(), this->fileInfoList.size());
+    for(int i = 0; i < kept; i++)
+    {
+        if(listing[i].fileName() != this->fileInfoList[i].fileName())
+            return false;
+    }
+    // after pages were removed from the end, new files would get their numbers and their cached images
+    if(listing.size() > this->fileInfoList.size() && this->fileInfoList.size() < usedPageCount)
+        return false;
+
+    this->fileInfoList = listing;
+    usedPageCount = std::max(usedPageCount, int(listing.size()));
+    return true;
+}
+
 QPixmap DirectoryComicSource::getPagePixmap(int pageNum)
 {
-    assert(pageNum >=0 && pageNum < this->getPageCount());
     auto cacheKey = QPair{id, pageNum};
     if(auto img = ImageCache::cache().getImage(cacheKey); !img.isNull()) {
         return img;
     }
 
-    QPixmap img(this->fileInfoList[pageNum].absoluteFilePath());
+    const QFileInfo file = pageFile(pageNum);
+    if(file.filePath().isEmpty()) return {};
+    auto img = Grayscale::toPixmap(ImageBufferPool::pool().decode(file.absoluteFilePath()));
     ImageCache::cache().addImage(cacheKey, img);
     return img;
 }
 
+QSize DirectoryComicSource::getPageSize(int pageNum)
+{
+    if(auto size = ComicSource::getPageSize(pageNum); size.isValid()) return size;
+    const QFileInfo file = pageFile(pageNum);
+    if(file.filePath().isEmpty()) return {};
+    return QImageReader(file.absoluteFilePath()).size();
+}
+
 QString DirectoryComicSource::getPageFilePath(int pageNum)
 {
-    assert(pageNum >=0 && pageNum < this->getPageCount());
-    return this->fileInfoList[pageNum].absoluteFilePath();
+    const QFileInfo file = pageFile(pageNum);
+    return file.filePath().isEmpty() ? QString{} : file.absoluteFilePath();
 }
 
 QString DirectoryComicSource::getTitle() const
@@ -198,15 +272,16 @@ ComicMetadata DirectoryComicSource::getComicMetadata() const
 
 PageMetadata DirectoryComicSource::getPageMetadata(int pageNum)
 {
-    assert(pageNum >=0 && pageNum < this->getPageCount());
     QMimeDatabase mdb;
     PageMetadata res;
+    const QFileInfo file = pageFile(pageNum);
+    if(file.filePath().isEmpty()) return res;
     auto px = getPagePixmap(pageNum);
     res.width = px.width();
     res.height = px.height();
-    res.fileName = this->fileInfoList[pageNum].fileName();
-    res.fileSize = this->fileInfoList[pageNum].size();
-    res.fileType = mdb.mimeTypeForFile(this->fileInfoList[pageNum]).name();
+    res.fileName = file.fileName();
+    res.fileSize = file.size();
+    res.fileType = mdb.mimeTypeForFile(file).name();
     res.valid = true;
     return res;
 }
@@ -216,6 +291,22 @@ int DirectoryComicSource::startAtPage() const
     return this->startPage;
 }
 
+const QSet<QString>& DirectoryComicSource::imageSuffixes()
+{
+    static const QSet<QString> suffixes = [] {
+        QSet<QString> res;
+        for(const auto& format: QImageReader::supportedImageFormats())
+            res.insert(QString::fromLatin1(format).toLower());
+        // formats that go by more than one suffix, like jpg and jpeg
+        QMimeDatabase mimeDb;
+        for(const auto& mime: QImageReader::supportedMimeTypes())
+            for(const auto& suffix: mimeDb.mimeTypeForName(QString::fromLatin1(mime)).suffixes())
+                res.insert(suffix.toLower());
+        return res;
+    }();
+    return suffixes;
+}
+
 bool DirectoryComicSource::fileSupported(const QFileInfo& info)
 {
     return info.isFile() && isImage(info.absoluteFilePath());
@@ -256,15 +347,8 @@ void DirectoryComicSource::readNeighborList()
         QDir dir(this->getPath());
         dir.setFilter(QDir::AllDirs | QDir::NoDotAndDotDot);
 
-        QCollator collator;
-        collator.setNumericMode(true);
-
         cachedNeighborList = dir.entryInfoList();
-
-        std::sort(cachedNeighborList.begin(), cachedNeighborList.end(),
-                  [&collator](const QFileInfo& file1, const QFileInfo& file2) {
-                      return collator.compare(file1.fileName(), file2.fileName()) < 0;
-                  });
+        NaturalSort::sort(cachedNeighborList);
     }
 }
 
@@ -439,61 +523,22 @@ ComicMetadata FileComicSource::getComicMetadata() const
     return res;
 }
 
-void FileComicSource::readNeighborList()
+bool FileComicSource::neighborsKnown()
 {
-
-    if(!cachedNeighborList.isEmpty()){
-        return;
-    }
-
-    QDir dir(this->getPath());
-    dir.setFilter(QDir::Files | QDir::NoDotAndDotDot);
-
-    QCollator collator;
-    collator.setNumericMode(true);
-
-    QMimeDatabase mimeDb;
     assert(!signatureMimeStr.isEmpty());
-    for(const auto& entry: dir.entryInfoList())
-    {
-        if(mimeDb.mimeTypeForFile(entry).inherits(signatureMimeStr))
-        {
-            cachedNeighborList.append(entry);
-        }
-    }
-
-    std::sort(cachedNeighborList.begin(), cachedNeighborList.end(),
-              [&collator](const QFileInfo& file1, const QFileInfo& file2) {
-                  return collator.compare(file1.fileName(), file2.fileName()) < 0;
-              });
+    return NeighborIndex::index().prefetch(this->getPath(), signatureMimeStr);
 }
 
 QString FileComicSource::getNextFilePath()
 {
-    readNeighborList();
-
-    auto length = cachedNeighborList.length();
-    for(int i = 0; i < length - 1; i++)
-    {
-        if(cachedNeighborList[i].absoluteFilePath() == this->getFilePath())
-            return cachedNeighborList[i + 1].absoluteFilePath();
-    }
-
-    return {};
+    assert(!signatureMimeStr.isEmpty());
+    return NeighborIndex::index().neighbor(this->getFilePath(), signatureMimeStr, 1);
 }
 
 QString FileComicSource::getPrevFilePath()
 {
-    readNeighborList();
-
-    auto length = cachedNeighborList.length();
-    for(int i = 1; i < length; i++)
-    {
-        if(cachedNeighborList[i].absoluteFilePath() == this->getFilePath())
-            return cachedNeighborList[i - 1].absoluteFilePath();
-    }
-
-    return {};
+    assert(!signatureMimeStr.isEmpty());
+    return NeighborIndex::index().neighbor(this->getFilePath(), signatureMimeStr, -1);
 }
 
 ZipComicSource::ZipComicSource(const QString& path)
@@ -507,39 +552,54 @@ ZipComicSource::ZipComicSource(const QString& path)
     if(zip->open(QuaZip::mdUnzip)) {
         this->currZipFile = new QuaZipFile(zip);
 
-        auto fInfo = zip->getFileInfoList();
+        // walks the central directory entry by entry instead of building the full file info list
         QMimeDatabase mimeDb;
         auto supportedImageFormats = QImageReader::supportedMimeTypes();
-        for(const auto& file: fInfo) {
+        for(bool more = zip->goToFirstFile(); more; more = zip->goToNextFile()) {
+            QuaZipFileInfo64 file;
+            if(!zip->getCurrentFileInfo(&file)) continue;
             bool fileOK = false;
             auto possibleMimes = mimeDb.mimeTypesForFileName(file.name);
             for(const auto& format: supportedImageFormats) {
                 for(const auto& possibleMime: possibleMimes) {
                     if(possibleMime.inherits(format)) {
-                        this->m_zipFileInfoList.append(file);
-                        fileOK = false;
+                        fileOK = true;
                         break;
                     }
                 }
                 if(fileOK)
                     break;
             }
+            if(fileOK)
+                this->pages.append(file.name, qint64(file.uncompressedSize));
         }
 
-        QCollator collator;
-        collator.setNumericMode(true);
+        this->pages.sortByName();
+        readComicInfo();
+    }
+}
+
+void ZipComicSource::readComicInfo()
+{
+    if(!this->zip->setCurrentFile(ComicInfo::fileName, QuaZip::csInsensitive) || !this->currZipFile->open(QIODevice::ReadOnly))
+        return;
+    const auto xml = this->currZipFile->readAll();
+    this->currZipFile->close();
 
-        std::sort(
-          this->m_zipFileInfoList.begin(), this->m_zipFileInfoList.end(),
-          [&collator](const QuaZipFileInfo& file1, const QuaZipFileInfo& file2) {
-              return collator.compare(file1.name, file2.name) < 0;
-          });
+    const auto table = ComicInfo::pageTable(xml, getPageCount());
+    for(auto it = table.cbegin(); it != table.cend(); ++it)
+    {
+        // a size that doesn't match means the page was replaced after tagging
+        if(it->fileSize > 0 && it->fileSize != this->pages.fileSize(it.key())) continue;
+        this->pages.setImageSize(it.key(), QSize(it->width, it->height));
+        this->pages.setBigPage(it.key(), it->isBigPage);
+        if(!it->tags.isEmpty()) this->pages.setPageType(it.key(), it->tags.first());
     }
 }
 
 int ZipComicSource::getPageCount() const
 {
-    return this->m_zipFileInfoList.length();
+    return this->pages.size();
 }
 
 QPixmap ZipComicSource::getPagePixmap(int pageNum)
@@ -547,19 +607,45 @@ QPixmap ZipComicSource::getPagePixmap(int pageNum)
     auto cacheKey = QPair{id, pageNum};
     if(auto img = ImageCache::cache().getImage(cacheKey); !img.isNull()) return img;
 
-    zipM.lock();
-    this->zip->setCurrentFile(this->m_zipFileInfoList[pageNum].name);
+    auto data = getPageData(pageNum);
+    if(data.isEmpty()) return {};
+    auto img = Grayscale::toPixmap(ImageBufferPool::pool().decode(data));
+    ImageCache::cache().addImage(cacheKey, img);
+    return img;
+}
+
+QByteArray ZipComicSource::getPageData(int pageNum)
+{
+    auto cacheKey = QPair{id, pageNum};
+    if(auto data = EncodedCache::cache().get(cacheKey); !data.isEmpty()) return data;
+
+    QMutexLocker locker(&zipM);
+    auto data = readEntry(pageNum);
+    if(!data.isEmpty()) EncodedCache::cache().add(cacheKey, data);
+    return data;
+}
+
+QByteArray ZipComicSource::readEntry(int pageNum)
+{
+    QByteArray data;
+    this->zip->setCurrentFile(this->pages.name(pageNum));
     if(this->currZipFile->open(QIODevice::ReadOnly))
     {
-        QPixmap img;
-        img.loadFromData(this->currZipFile->readAll());
+        data = this->currZipFile->readAll();
         this->currZipFile->close();
-        zipM.unlock();
-        ImageCache::cache().addImage(cacheKey, img);
-        return img;
     }
+    return data;
+}
+
+bool ZipComicSource::prefetchPageData(int pageNum)
+{
+    auto cacheKey = QPair{id, pageNum};
+    if(EncodedCache::cache().hasKey(cacheKey)) return true;
+    // one entry at a time, a page load waiting for the archive never waits for more than that
+    if(!zipM.tryLock()) return false;
+    auto data = readEntry(pageNum);
     zipM.unlock();
-    return {};
+    return !data.isEmpty() && EncodedCache::cache().add(cacheKey, data);
 }
 
 QString ZipComicSource::getPageFilePath(int pageNum)
@@ -568,12 +654,7 @@ QString ZipComicSource::getPageFilePath(int pageNum)
     tmp.setAutoRemove(false);
     if(tmp.open())
     {
-        this->zip->setCurrentFile(this->m_zipFileInfoList[pageNum].name);
-        if(this->currZipFile->open(QIODevice::ReadOnly))
-        {
-            tmp.write(this->currZipFile->readAll());
-            this->currZipFile->close();
-        }
+        tmp.write(getPageData(pageNum));
         tmp.close();
     }
     return tmp.fileName();
@@ -581,28 +662,66 @@ QString ZipComicSource::getPageFilePath(int pageNum)
 
 
 
-PageMetadata ZipComicSource::getPageMetadata(int pageNum)
+QPixmap ZipComicSource::getPagePreview(int pageNum)
 {
-    if(metaDataCache.count(pageNum)) return metaDataCache[pageNum];
+    if(auto thumb = ComicSource::getPagePreview(pageNum); !thumb.isNull()) return thumb;
 
-    PageMetadata res;
-    auto px = getPagePixmap(pageNum);
-    res.width = px.width();
-    res.height = px.height();
-    res.fileName = this->m_zipFileInfoList[pageNum].name;
-    res.fileSize = this->m_zipFileInfoList[pageNum].uncompressedSize;
+    // this runs on the GUI thread, reading and inflating the entry is left to the page loader.
+    auto data = EncodedCache::cache().get({id, pageNum});
+    if(data.isEmpty()) return {};
 
-    QMimeDatabase mdb;
-    auto possibleMimes = mdb.mimeTypesForFileName(res.fileName);
-    if(!possibleMimes.empty()) {
-        res.fileType = possibleMimes[0].name();
-    } else {
-        res.fileType = "unknown";
+    // only worth it for formats that can decode at reduced size (jpeg: 1/2, 1/4, 1/8).
+    QBuffer buffer(&data);
+    QImageReader reader(&buffer);
+    auto size = reader.size();
+    if(!size.isValid() || !reader.supportsOption(QImageIOHandler::ScaledSize)) return {};
+    reader.setScaledSize(size / 4);
+    return QPixmap::fromImage(reader.read());
+}
+
+QSize ZipComicSource::getPageSize(int pageNum)
+{
+    if(auto size = ComicSource::getPageSize(pageNum); size.isValid()) return size;
+    if(auto size = this->pages.imageSize(pageNum); size.isValid()) return size;
+
+    QSize size;
+    if(auto data = EncodedCache::cache().get({id, pageNum}); !data.isEmpty())
+    {
+        QBuffer buffer(&data);
+        size = QImageReader(&buffer).size();
+    }
+    else
+    {
+        // this runs on the GUI thread, the caller asks again later if the archive is busy.
+        if(!zipM.tryLock()) return {};
+        this->zip->setCurrentFile(this->pages.name(pageNum));
+        if(this->currZipFile->open(QIODevice::ReadOnly))
+        {
+            // only the header is inflated
+            size = QImageReader(this->currZipFile).size();
+            this->currZipFile->close();
+        }
+        zipM.unlock();
     }
+    if(size.isValid()) this->pages.setImageSize(pageNum, size);
+    return size;
+}
 
-    res.valid = true;
-    metaDataCache[pageNum] = res;
-    return res;
+PageMetadata ZipComicSource::getPageMetadata(int pageNum)
+{
+    if(!this->pages.imageSize(pageNum).isValid())
+    {
+        // waits for the archive unlike getPageSize, but still only reads the image header
+        QSize size = ComicSource::getPageSize(pageNum);
+        if(!size.isValid())
+        {
+            auto data = getPageData(pageNum);
+            QBuffer buffer(&data);
+            size = QImageReader(&buffer).size();
+        }
+        if(size.isValid()) this->pages.setImageSize(pageNum, size);
+    }
+    return this->pages.metadata(pageNum);
 }
 
 ZipComicSource::~ZipComicSource()
@@ -742,7 +861,7 @@ QPixmap HydrusSearchQuerySource::getPagePixmap(int pageNum)
     auto cacheKey = QPair{id, pageNum};
     if(auto img = ImageCache::cache().getImage(cacheKey); !img.isNull()) return img;
 
-    QPixmap img(filePaths[pageNum]);
+    auto img = Grayscale::toPixmap(ImageBufferPool::pool().decode(filePaths[pageNum]));
     ImageCache::cache().addImage(cacheKey, img);
     return img;
 }
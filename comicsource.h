@@ -20,13 +20,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define COMICSOURCE_H
 
 #include "metadata.h"
+#include "pagetable.h"
 #include <QFileInfoList>
 #include <QPixmap>
 #include <QString>
 #include <QMutex>
+#include <QReadWriteLock>
 #include <QHash>
+#include <QSet>
 #include <quazipfileinfo.h>
-#include <mobi.h>
 #include <QMimeType>
 
 class QuaZip;
@@ -51,12 +53,35 @@ public:
     bool isValidPage(int pageNum) const {
             return pageNum >= 0 && pageNum < getPageCount();
     }
-    bool hasPagePixmap(int pageNum) const;
+    // true if getPagePixmap returns the page without decoding or rendering it
+    virtual bool hasPagePixmap(int pageNum) const;
+    // cheap low resolution stand-in for a page that is not decoded yet,
+    // may return a null pixmap if nothing is available.
+    virtual QPixmap getPagePreview(int pageNum);
+    // pixel size of a page, read from the image header where possible so the page isn't decoded.
+    // returns an invalid size if it can't be determined right now.
+    virtual QSize getPageSize(int pageNum);
+    // the page for showing at about target pixels. Sources that rasterize vector pages render it
+    // at the matching resolution instead of the full one, the others return getPagePixmap.
+    virtual QPixmap getPagePixmapForSize(int pageNum, const QSize& target);
+    // the area pages are fitted into on screen in device pixels,
+    // sources that rasterize pages pick the resolution of getPagePixmap from it.
+    virtual void setDisplaySize(const QSize&) {}
+    // true for pages that can be rendered at any resolution, like the vector pages of a PDF
+    virtual bool isScalablePage(int) { return false; }
+    // renders the part rect of a scalable page at the resolution where the whole page is pageSize pixels
+    virtual QImage renderPageRegion(int, const QSize&, const QRect&) { return {}; }
+    // reads the page file into EncodedCache without decoding it, for prefetching ahead of the decoded pages.
+    // returns false when reading further ahead is pointless right now (cache full, source busy)
+    virtual bool prefetchPageData(int) { return false; }
 
     virtual ComicMetadata getComicMetadata() const = 0;
     virtual PageMetadata getPageMetadata(int pageNum) = 0;
     virtual void setPageMetadata(int pageNum, PageMetadata) {}
     virtual bool ephemeral() const;
+    // false while the comics next to this one are still being looked up, hasNextComic and
+    // hasPreviousComic would wait for that. The lookup goes on in the background.
+    virtual bool neighborsKnown() { return true; }
     virtual int startAtPage() const;
     virtual void resortFiles() {}
     virtual ~ComicSource() {}
@@ -79,14 +104,13 @@ public:
     virtual ComicSource* previousComic() override;
     virtual bool hasNextComic() override;
     virtual bool hasPreviousComic() override;
-    virtual void readNeighborList();
+    virtual bool neighborsKnown() override;
 
     QString getNextFilePath();
     QString getPrevFilePath();
 
 protected:
     QString signatureMimeStr{};
-    QFileInfoList cachedNeighborList;
     QString path;
     // QString id;
 };
@@ -99,14 +123,22 @@ public:
     virtual QPixmap getPagePixmap(int pageNum) override;
     virtual QString getPageFilePath(int pageNum) override;
     virtual PageMetadata getPageMetadata(int pageNum) override;
+    virtual QPixmap getPagePreview(int pageNum) override;
+    virtual QSize getPageSize(int pageNum) override;
+    virtual bool prefetchPageData(int pageNum) override;
     virtual ~ZipComicSource();
 
 protected:
+    // the page file as stored in the archive, from EncodedCache if possible
+    QByteArray getPageData(int pageNum);
+    // expects zipM to be held
+    QByteArray readEntry(int pageNum);
+    // fills in the page table from ComicInfo.xml, if the archive has one
+    void readComicInfo();
     QMutex zipM;
-    QList<QuaZipFileInfo> m_zipFileInfoList;
+    PageTable pages;
     QuaZip* zip = nullptr;
     QuaZipFile* currZipFile = nullptr;
-    QHash<int, PageMetadata> metaDataCache;
 };
 
 class EpubComicSource final : public ZipComicSource
@@ -123,6 +155,7 @@ public:
     DirectoryComicSource(const QString& filePath);
     virtual int getPageCount() const override;
     virtual QPixmap getPagePixmap(int pageNum) override;
+    virtual QSize getPageSize(int pageNum) override;
     virtual QString getPageFilePath(int pageNum) override;
     virtual QString getTitle() const override;
     virtual QString getFilePath() const override;
@@ -136,12 +169,24 @@ public:
     virtual PageMetadata getPageMetadata(int pageNum) override;
     virtual int startAtPage() const override;
     static bool fileSupported(const QFileInfo &info);
+    // lower case suffixes of the image formats that can be read
+    static const QSet<QString>& imageSuffixes();
+    // takes over the pages of a newer listing of the same folder in place. Files added after the last page
+    // and files removed from the end keep the numbers of the other pages the same. Returns false if the
+    // numbers would change, then the folder has to be opened again.
+    bool update(const DirectoryComicSource& newer);
 
 private:
     QString getNextFilePath();
     QString getPrevFilePath();
     void readNeighborList();
+    // an empty QFileInfo past the end, pages can be removed while workers still load them
+    QFileInfo pageFile(int pageNum) const;
+    // guards fileInfoList, which update() changes on the GUI thread while workers read pages
+    mutable QReadWriteLock listLock;
     QFileInfoList fileInfoList;
+    // every page number that was given to a file under this id, cached pages exist for those
+    int usedPageCount = 0;
     QFileInfoList cachedNeighborList;
     QString path;
     // QString id;
@@ -0,0 +1,151 @@
+#include "diskpagecache.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr quint32 pageFileMagic = 0x47504351; // "QCPG"
+    constexpr quint32 pageFileVersion = 1;
+
+    struct PageFileHeader
+    {
+        quint32 magic = pageFileMagic;
+        quint32 version = pageFileVersion;
+        qint32 width = 0;
+        qint32 height = 0;
+        qint32 bytesPerLine = 0;
+        qint32 format = QImage::Format_Invalid;
+        // keeps the scanlines 16 byte aligned in the mapping
+        quint32 reserved[2] = {};
+    };
+    static_assert(sizeof(PageFileHeader) == 32);
+
+    void unmapPageFile(void* info)
+    {
+        // closing the file drops the mapping
+        delete static_cast<QFile*>(info);
+    }
+}
+
+DiskPageCache& DiskPageCache::cache()
+{
+    static DiskPageCache cache;
+    return cache;
+}
+
+QImage DiskPageCache::getImage(const QString& id, int page, const QString& params)
+{
+    QMutexLocker lock(&mut);
+    if(maxBytes == 0) return {};
+
+    const QString name = fileName(id, page, params);
+    auto it = std::find_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.name == name; });
+    if(it == entries.end()) return {};
+
+    auto file = new QFile(dir + "/" + name);
+    PageFileHeader header;
+    uchar* data = nullptr;
+    if(file->open(QIODevice::ReadOnly) && file->size() > qint64(sizeof(header)))
+    {
+        data = file->map(0, file->size());
+        if(data) std::memcpy(&header, data, sizeof(header));
+    }
+    const qint64 expected = qint64(sizeof(header)) + qint64(header.bytesPerLine) * header.height;
+    if(!data || header.magic != pageFileMagic || header.version != pageFileVersion || file->size() != expected)
+    {
+        delete file;
+        QFile::remove(dir + "/" + name);
+        bytes -= it->size;
+        entries.erase(it);
+        return {};
+    }
+
+    // move to the back so the least recently used entries are trimmed first, also across restarts
+    entries.append(*it);
+    entries.erase(it);
+    file->setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+    // the image reads the mapped pages directly and unmaps them when its last copy goes away,
+    // being const it detaches before anything writes to it
+    return QImage(static_cast<const uchar*>(data) + sizeof(header), header.width, header.height, header.bytesPerLine,
+                  QImage::Format(header.format), unmapPageFile, file);
+}
+
+void DiskPageCache::addImage(const QString& id, int page, const QString& params, const QImage& img)
+{
+    if(img.isNull() || !isEnabled()) return;
+
+    PageFileHeader header;
+    header.width = img.width();
+    header.height = img.height();
+    header.bytesPerLine = img.bytesPerLine();
+    header.format = img.format();
+    const qint64 size = qint64(sizeof(header)) + img.sizeInBytes();
+
+    QMutexLocker lock(&mut);
+    if(size > maxBytes) return;
+    const QString name = fileName(id, page, params);
+    if(std::any_of(entries.cbegin(), entries.cend(), [&](const Entry& e) { return e.name == name; })) return;
+
+    maintain(size);
+    // written under a temporary name, a crash never leaves a truncated page behind
+    QSaveFile file(dir + "/" + name);
+    if(!file.open(QIODevice::WriteOnly)
+       || file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != qint64(sizeof(header))
+       || file.write(reinterpret_cast<const char*>(img.constBits()), img.sizeInBytes()) != img.sizeInBytes()
+       || !file.commit())
+    {
+        qDebug() << "Failed to write page cache file" << file.fileName() << file.errorString();
+        return;
+    }
+    entries.append({name, size});
+    bytes += size;
+}
+
+bool DiskPageCache::isEnabled() const
+{
+    return maxBytes > 0;
+}
+
+void DiskPageCache::initialize(const QString& dir, qint64 maxBytes)
+{
+    QMutexLocker lock(&mut);
+    this->dir = dir;
+    this->maxBytes = 0;
+    entries.clear();
+    bytes = 0;
+    if(maxBytes <= 0 || !QDir{}.mkpath(dir)) return;
+    this->maxBytes = maxBytes;
+
+    // QDir::Time sorts newest first
+    const auto files = QDir(dir).entryInfoList({"*.page"}, QDir::Files, QDir::Time | QDir::Reversed);
+    for(const auto& info: files)
+    {
+        entries.append({info.fileName(), info.size()});
+        bytes += info.size();
+    }
+    maintain(0);
+}
+
+QString DiskPageCache::fileName(const QString& id, int page, const QString& params) const
+{
+    const QString key = id + "/" + QString::number(page) + "/" + params;
+    return QString::fromLatin1(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex()) + ".page";
+}
+
+void DiskPageCache::maintain(qint64 incoming)
+{
+    while(!entries.isEmpty() && bytes + incoming > maxBytes)
+    {
+        QFile::remove(dir + "/" + entries.front().name);
+        bytes -= entries.front().size;
+        entries.pop_front();
+    }
+}
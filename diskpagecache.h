@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+/**
+ * Decoded pages on disk, for sources where producing the pixels costs far more than reading
+ * them back (PDF rendering, unrar). Each page is one file with a small header followed by the
+ * raw scanlines, which are mapped into memory on a hit instead of being read through a buffer.
+ * Entries are keyed by source id, page number and the parameters the page was produced with
+ * and trimmed to a size limit, least recently used first.
+ */
+class DiskPageCache
+{
+public:
+    static DiskPageCache& cache();
+    // a null image on a miss or when the cache is disabled
+    QImage getImage(const QString& id, int page, const QString& params);
+    void addImage(const QString& id, int page, const QString& params, const QImage& img);
+    bool isEnabled() const;
+    // maxBytes 0 disables the cache, existing entries are trimmed to the new limit
+    void initialize(const QString& dir, qint64 maxBytes);
+
+private:
+    struct Entry
+    {
+        QString name;
+        qint64 size = 0;
+    };
+    QString fileName(const QString& id, int page, const QString& params) const;
+    void maintain(qint64 incoming);
+    QString dir;
+    qint64 maxBytes = 0;
+    qint64 bytes = 0;
+    // oldest first
+    QList<Entry> entries;
+    QMutex mut;
+};
@@ -0,0 +1,130 @@
+#include "edgecolor.h"
+#include <algorithm>
+#include <memory>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr int binCount = 1 << 13;
+
+    struct DenseHistogram
+    {
+        quint32 count[binCount] = {};
+        quint32 r[binCount] = {};
+        quint32 g[binCount] = {};
+        quint32 b[binCount] = {};
+        quint32 a[binCount] = {};
+
+        inline void add(quint32 key, QRgb px)
+        {
+            count[key]++;
+            r[key] += qRed(px);
+            g[key] += qGreen(px);
+            b[key] += qBlue(px);
+            a[key] += qAlpha(px);
+        }
+    };
+
+    inline quint32 binKey(QRgb px)
+    {
+        return ((px >> 31) << 12) | ((px >> 12) & 0xF00) | ((px >> 8) & 0xF0) | ((px >> 4) & 0xF);
+    }
+
+    // px is a contiguous run of ARGB32 pixels
+    void accumulate(DenseHistogram& hist, const QRgb* px, int len, int step)
+    {
+        int i = 0;
+#ifdef __SSE2__
+        if(step == 1)
+        {
+            const __m128i maskR = _mm_set1_epi32(0xF00);
+            const __m128i maskG = _mm_set1_epi32(0xF0);
+            const __m128i maskB = _mm_set1_epi32(0xF);
+            alignas(16) quint32 keys[4];
+            for(; i + 4 <= len; i += 4)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(px + i));
+                __m128i k = _mm_slli_epi32(_mm_srli_epi32(v, 31), 12);
+                k = _mm_or_si128(k, _mm_and_si128(_mm_srli_epi32(v, 12), maskR));
+                k = _mm_or_si128(k, _mm_and_si128(_mm_srli_epi32(v, 8), maskG));
+                k = _mm_or_si128(k, _mm_and_si128(_mm_srli_epi32(v, 4), maskB));
+                _mm_store_si128(reinterpret_cast<__m128i*>(keys), k);
+                hist.add(keys[0], px[i]);
+                hist.add(keys[1], px[i + 1]);
+                hist.add(keys[2], px[i + 2]);
+                hist.add(keys[3], px[i + 3]);
+            }
+        }
+#endif
+        for(; i < len; i += step) hist.add(binKey(px[i]), px[i]);
+    }
+
+    void accumulateStrip(DenseHistogram& hist, const QImage& img, const QRect& rect, int step)
+    {
+        // a 1 pixel wide strip converted on its own is contiguous in memory, and the
+        // conversion only touches the border instead of the whole page.
+        QImage strip = img.copy(rect).convertToFormat(QImage::Format_ARGB32);
+        if(strip.isNull()) return;
+        accumulate(hist, reinterpret_cast<const QRgb*>(strip.constBits()), strip.width() * strip.height(), step);
+    }
+}
+
+EdgeColorHistogram EdgeColorHistogram::fromImage(const QImage& img, int step)
+{
+    EdgeColorHistogram res;
+    const int w = img.width();
+    const int h = img.height();
+    if(w <= 0 || h <= 0) return res;
+    step = std::max(1, step);
+
+    auto hist = std::make_unique<DenseHistogram>();
+    accumulateStrip(*hist, img, QRect(0, 0, w, 1), step);
+    if(h > 1) accumulateStrip(*hist, img, QRect(0, h - 1, w, 1), step);
+    accumulateStrip(*hist, img, QRect(0, 0, 1, h), step);
+    if(w > 1) accumulateStrip(*hist, img, QRect(w - 1, 0, 1, h), step);
+
+    for(int key = 0; key < binCount; key++)
+    {
+        if(hist->count[key])
+            res.bins.append({quint16(key), hist->count[key], hist->r[key], hist->g[key], hist->b[key], hist->a[key]});
+    }
+    return res;
+}
+
+QColor EdgeColorHistogram::mostCommonColor(const EdgeColorHistogram& left, const EdgeColorHistogram& right)
+{
+    // both bin lists are sorted by key, merge them while looking for the largest bin.
+    Bin best;
+    auto consider = [&best](const Bin& bin) {
+        if(bin.count > best.count) best = bin;
+    };
+    int i = 0, j = 0;
+    while(i < left.bins.size() || j < right.bins.size())
+    {
+        if(j == right.bins.size() || (i < left.bins.size() && left.bins[i].key < right.bins[j].key))
+        {
+            consider(left.bins[i++]);
+        }
+        else if(i == left.bins.size() || right.bins[j].key < left.bins[i].key)
+        {
+            consider(right.bins[j++]);
+        }
+        else
+        {
+            Bin sum = left.bins[i++];
+            const Bin& other = right.bins[j++];
+            sum.count += other.count;
+            sum.r += other.r;
+            sum.g += other.g;
+            sum.b += other.b;
+            sum.a += other.a;
+            consider(sum);
+        }
+    }
+
+    if(best.count == 0) return Qt::transparent;
+    return QColor(best.r / best.count, best.g / best.count, best.b / best.count, best.a / best.count);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QColor>
+#include <QImage>
+#include <QVector>
+
+/**
+ * Histogram of the border pixels of a page, used for the dynamic background.
+ * Colors are quantized to 4 bits per channel plus an opaque/transparent bit,
+ * each bin keeps the channel sums so the average color of the winning bin is returned.
+ * Only non-empty bins are stored, so it is cheap to keep next to a cached page.
+ */
+class EdgeColorHistogram
+{
+public:
+    static EdgeColorHistogram fromImage(const QImage& img, int step = 1);
+    static QColor mostCommonColor(const EdgeColorHistogram& left, const EdgeColorHistogram& right);
+    bool isEmpty() const { return bins.isEmpty(); }
+
+private:
+    struct Bin
+    {
+        quint16 key = 0;
+        quint32 count = 0;
+        quint32 r = 0, g = 0, b = 0, a = 0;
+    };
+    QVector<Bin> bins;
+};
@@ -0,0 +1,70 @@
+#include "encodedcache.h"
+#include <QMutexLocker>
+#include "memorygovernor.h"
+
+EncodedCache& EncodedCache::cache()
+{
+    static EncodedCache cache;
+    return cache;
+}
+
+QByteArray EncodedCache::get(const QPair<QString, int>& key)
+{
+    QMutexLocker lock(&mut);
+    return storage.value(key);
+}
+
+bool EncodedCache::add(const QPair<QString, int>& key, const QByteArray& data)
+{
+    QMutexLocker lock(&mut);
+    if(storage.contains(key)) return true;
+    if(data.size() > maxBytes) return false;
+
+    maintain(data.size(), maxBytes);
+    storage.insert(key, data);
+    keys.push_back(key);
+    bytes += data.size();
+    lock.unlock();
+    MemoryGovernor::governor().rebalance();
+    return true;
+}
+
+bool EncodedCache::hasKey(const QPair<QString, int>& key)
+{
+    QMutexLocker lock(&mut);
+    return storage.contains(key);
+}
+
+void EncodedCache::initialize(qint64 maxBytes, int readAheadCount)
+{
+    QMutexLocker lock(&mut);
+    this->maxBytes = maxBytes;
+    this->readAhead = readAheadCount;
+    maintain(0, maxBytes);
+}
+
+int EncodedCache::readAheadCount() const
+{
+    return readAhead;
+}
+
+qint64 EncodedCache::byteSize()
+{
+    QMutexLocker lock(&mut);
+    return bytes;
+}
+
+void EncodedCache::shrinkTo(qint64 limit)
+{
+    QMutexLocker lock(&mut);
+    maintain(0, limit);
+}
+
+void EncodedCache::maintain(qint64 incoming, qint64 limit)
+{
+    while(!keys.isEmpty() && bytes + incoming > limit)
+    {
+        bytes -= storage.take(keys.front()).size();
+        keys.pop_front();
+    }
+}
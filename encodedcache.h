@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+
+/**
+ * Second cache tier below ImageCache: the page files as they are stored in the archive
+ * (still JPEG/PNG compressed), keyed like ImageCache by source id and page number.
+ * A page evicted from ImageCache is decoded again from here without touching the archive.
+ * Sources fill it by reading ahead in archive order. Oldest entries are dropped first.
+ */
+class EncodedCache
+{
+public:
+    static EncodedCache& cache();
+    QByteArray get(const QPair<QString, int>& key);
+    // returns false if the data is larger than the whole budget and was not stored
+    bool add(const QPair<QString, int>& key, const QByteArray& data);
+    bool hasKey(const QPair<QString, int>& key);
+    void initialize(qint64 maxBytes, int readAheadCount);
+    // how many pages after a requested one sources should read into the cache
+    int readAheadCount() const;
+    qint64 byteSize();
+    void shrinkTo(qint64 limit);
+
+private:
+    // expects mut to be held
+    void maintain(qint64 incoming, qint64 limit);
+    qint64 maxBytes = 0;
+    qint64 bytes = 0;
+    int readAhead = 0;
+    QHash<QPair<QString, int>, QByteArray> storage;
+    QList<QPair<QString, int>> keys;
+    QMutex mut;
+};
@@ -1,81 +1,177 @@
-
 #include <QDebug>
 #include <quazip.h>
 #include <quazipfile.h>
 #include "comicsource.h"
-#include <QDomDocument>
-#include <QDomElement>
-#include "helper.h"
+#include <QDir>
+#include <QHash>
+#include <QUrl>
+#include <QThread>
+#include <QXmlStreamReader>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <atomic>
 
-int readZipFileToDom(QDomDocument &domfile, QuaZip* zip, const QString& filename)
+namespace
 {
-    auto zipfile = QuaZipFile(zip);
-    zip->setCurrentFile(filename);
-    zipfile.open(QIODevice::ReadOnly);
-    domfile.setContent(zipfile.readAll());
-    zipfile.close();
-    return 0;
+    // spine documents below which opening another handle on the archive for a helper thread doesn't pay off
+    constexpr int documentsPerThread = 64;
+
+    QString directoryOf(const QString& path)
+    {
+        const int slash = path.lastIndexOf('/');
+        return slash < 0 ? QString{} : path.left(slash);
+    }
+
+    // archive path of a reference from a document in baseDir, empty for external resources
+    QString resolveHref(const QString& baseDir, const QString& href)
+    {
+        QString path = QUrl::fromPercentEncoding(href.section('#', 0, 0).toUtf8());
+        if(path.isEmpty() || path.contains(':')) return {};
+        if(path.startsWith('/')) return QDir::cleanPath(path.mid(1));
+        return QDir::cleanPath(baseDir.isEmpty() ? path : baseDir + '/' + path);
+    }
+
+    bool openEntry(QuaZip* zip, QuaZipFile& file, const QString& name)
+    {
+        return zip->setCurrentFile(name) && file.open(QIODevice::ReadOnly);
+    }
+
+    QString packagePath(QIODevice* container)
+    {
+        QXmlStreamReader xml(container);
+        while(!xml.atEnd())
+        {
+            if(xml.readNext() == QXmlStreamReader::StartElement && xml.name() == QLatin1String("rootfile"))
+                return xml.attributes().value("full-path").toString();
+        }
+        return {};
+    }
+
+    // the image a fixed layout page shows, either as <img src> or as SVG <image xlink:href>
+    QString firstImageReference(QIODevice* document)
+    {
+        QXmlStreamReader xml(document);
+        while(!xml.atEnd())
+        {
+            if(xml.readNext() != QXmlStreamReader::StartElement) continue;
+            const auto attributes = xml.attributes();
+            if(xml.name() == QLatin1String("img"))
+                return attributes.value("src").toString();
+            if(xml.name() == QLatin1String("image"))
+            {
+                auto href = attributes.value("http://www.w3.org/1999/xlink", "href");
+                return (href.isEmpty() ? attributes.value("href") : href).toString();
+            }
+        }
+        return {};
+    }
 }
 
 /**
- * @TODO
- * - parse <spine></spine> get idref, use idref as index for html page, then get image src from there.
- *
- * mimetype detection not needed. (maybe not needed, only image order is used in epub parsing)
- * zipsource is used as image scanner, epub/cbr, is used to order imgs or add metadata.
+ * Pages follow the reading order of the spine in the OPF package.
+ * Spine items that are images are pages directly, for (X)HTML and SVG items the first image they reference is.
+ * Documents are only streamed up to that reference, on several threads for long books.
+ * If the spine yields no pages, all images of the archive are shown in natural order like in a plain zip.
  */
 EpubComicSource::EpubComicSource(const QString& path):ZipComicSource(path)
 {
-    QString protocolRootPath, realRootPath;
-
-    protocolRootPath = "META-INF/container.xml";
-    QDomDocument contentPage;
-    readZipFileToDom(contentPage, this->zip, protocolRootPath);
-
-    realRootPath = contentPage.documentElement()
-                        .firstChildElement()
-                        .firstChildElement()
-                        .attribute("full-path");
-
-    if(1) {
-        readZipFileToDom(contentPage, this->zip, realRootPath);
-        auto item = contentPage.documentElement()
-                    .firstChildElement("manifest")
-                    .firstChildElement("item");
-
-        QStringList imgs;
-        while(!item.isNull()){
-            if(!item.attribute("id").startsWith("Page")){
-                item = item.nextSiblingElement();
-                continue;
-            }
-            auto htmlPath = item.attribute("href");
-            QDomDocument htmlPage;
-            readZipFileToDom(htmlPage, this->zip, htmlPath);
-            QString imgPath = htmlPage.documentElement()
-                                .firstChildElement("body")
-                                .firstChildElement()
-                                .firstChildElement()
-                                .firstChildElement()
-                                .attribute("src").mid(3);
-            imgs.push_back(imgPath);
-            item = item.nextSiblingElement();
-        }
+    if(!this->currZipFile) return;
+
+    QString opfPath;
+    if(openEntry(this->zip, *this->currZipFile, "META-INF/container.xml"))
+    {
+        opfPath = packagePath(this->currZipFile);
+        this->currZipFile->close();
+    }
+    if(opfPath.isEmpty() || !openEntry(this->zip, *this->currZipFile, opfPath))
+    {
+        qDebug() << "epub without a readable package document, using the archive order";
+        return;
+    }
+
+    // manifest id -> archive path and media type
+    QHash<QString, QPair<QString, QString>> manifest;
+    QStringList spine;
+    const QString opfDir = directoryOf(opfPath);
+    QXmlStreamReader xml(this->currZipFile);
+    while(!xml.atEnd())
+    {
+        if(xml.readNext() != QXmlStreamReader::StartElement) continue;
+        const auto attributes = xml.attributes();
+        if(xml.name() == QLatin1String("item"))
+            manifest.insert(attributes.value("id").toString(),
+                            {resolveHref(opfDir, attributes.value("href").toString()), attributes.value("media-type").toString()});
+        else if(xml.name() == QLatin1String("itemref"))
+            spine.append(attributes.value("idref").toString());
+    }
+    this->currZipFile->close();
 
-        QList<QuaZipFileInfo> li;
-        auto accer = [](QuaZipFileInfo x)->QString{return x.name;};
-        // filterWithIndex(this->fileInfoList, li, imgs, accer);
+    // images straight from the spine, documents get their image filled in below
+    QStringList pageImages;
+    QStringList documents;
+    QVector<int> documentPages;
+    for(const auto& idref: spine)
+    {
+        const auto item = manifest.value(idref);
+        if(item.first.isEmpty()) continue;
+        if(item.second.startsWith("image/") && item.second != "image/svg+xml")
+        {
+            pageImages.append(item.first);
+        }
+        else
+        {
+            documentPages.append(pageImages.size());
+            documents.append(item.first);
+            pageImages.append({});
+        }
+    }
 
-        for(auto imgPath: imgs) {
-            auto _info = std::find_if(this->m_zipFileInfoList.begin(), this->m_zipFileInfoList.end(),
-                    [imgPath](auto&&  f) { return imgPath == f.name; });
-            if(_info != this->m_zipFileInfoList.end()){ li.push_back(*_info); }
+    // written by index from several threads, so no implicitly shared container
+    QVector<QString> documentImages(documents.size());
+    QString* found = documentImages.data();
+    std::atomic<int> nextDocument{0};
+    auto work = [&](QuaZip* zip) {
+        QuaZipFile file(zip);
+        for(int i = nextDocument++; i < documents.size(); i = nextDocument++)
+        {
+            if(!openEntry(zip, file, documents[i])) continue;
+            const QString href = firstImageReference(&file);
+            file.close();
+            found[i] = resolveHref(directoryOf(documents[i]), href);
         }
-        this->m_zipFileInfoList.clear();
-        this->m_zipFileInfoList = li;
-    } else {
-        qDebug()<<"error to get contents file";
+    };
+    // every helper reads through its own handle on the archive, the calling thread uses the source's
+    const int threads = std::min(QThread::idealThreadCount(), documents.size() / documentsPerThread);
+    QVector<QFuture<void>> helpers;
+    for(int i = 1; i < threads; i++)
+    {
+        helpers.append(QtConcurrent::run([&work, path]() {
+            QuaZip zip(path);
+            if(zip.open(QuaZip::mdUnzip)) work(&zip);
+        }));
+    }
+    work(this->zip);
+    for(auto& f: helpers) f.waitForFinished();
+    for(int i = 0; i < documents.size(); i++)
+        pageImages[documentPages[i]] = documentImages[i];
+
+    QHash<QString, int> entryIndex;
+    entryIndex.reserve(this->pages.size());
+    for(int i = 0; i < this->pages.size(); i++)
+        entryIndex.insert(this->pages.name(i), i);
+
+    QVector<int> order;
+    for(const auto& imgPath: pageImages)
+    {
+        if(auto it = entryIndex.constFind(imgPath); it != entryIndex.cend())
+            order.push_back(*it);
+    }
+    if(order.isEmpty())
+    {
+        qDebug() << "no pages found in the epub spine, using the archive order";
+        return;
     }
+    this->pages.reorder(order);
 }
 
 // parsing:
@@ -0,0 +1,97 @@
+#include "grayscale.h"
+#include "imagebufferpool.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    bool is32BitFormat(QImage::Format format)
+    {
+        return format == QImage::Format_RGB32 || format == QImage::Format_ARGB32 || format == QImage::Format_ARGB32_Premultiplied;
+    }
+
+    // a pixel is gray if B == G == R and it is fully opaque
+    bool rowIsGray(const quint32* row, int w)
+    {
+        int x = 0;
+#ifdef __SSE2__
+        const __m128i channelMask = _mm_set1_epi32(0x0000FFFF);
+        const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+        __m128i bad = _mm_setzero_si128();
+        for(; x + 4 <= w; x += 4)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            // (B ^ G) in the low byte and (G ^ R) in the next one, both zero for gray
+            const __m128i diff = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi32(v, 8)), channelMask);
+            bad = _mm_or_si128(bad, _mm_or_si128(diff, _mm_andnot_si128(v, alphaMask)));
+        }
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(bad, _mm_setzero_si128())) != 0xFFFF) return false;
+#endif
+        for(; x < w; x++)
+        {
+            const quint32 p = row[x];
+            if(((p ^ (p >> 8)) & 0xFFFF) != 0 || (p >> 24) != 0xFF) return false;
+        }
+        return true;
+    }
+
+    void packRow(const quint32* src, uchar* dst, int w)
+    {
+        int x = 0;
+#ifdef __SSE2__
+        const __m128i lowByte = _mm_set1_epi32(0xFF);
+        for(; x + 16 <= w; x += 16)
+        {
+            const __m128i* s = reinterpret_cast<const __m128i*>(src + x);
+            const __m128i a = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128(s), lowByte), _mm_and_si128(_mm_loadu_si128(s + 1), lowByte));
+            const __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128(s + 2), lowByte), _mm_and_si128(_mm_loadu_si128(s + 3), lowByte));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(a, b));
+        }
+#endif
+        for(; x < w; x++) dst[x] = uchar(src[x]);
+    }
+}
+
+bool Grayscale::isGrayscale(const QImage& img)
+{
+    if(img.isNull()) return false;
+    if(img.format() == QImage::Format_Grayscale8) return true;
+    if(img.format() == QImage::Format_Indexed8)
+    {
+        for(const QRgb c: img.colorTable())
+        {
+            if(qAlpha(c) != 255 || qRed(c) != qGreen(c) || qGreen(c) != qBlue(c)) return false;
+        }
+        return true;
+    }
+    if(!is32BitFormat(img.format())) return false;
+
+    // colored pages usually fail within the first rows
+    for(int y = 0; y < img.height(); y++)
+    {
+        if(!rowIsGray(reinterpret_cast<const quint32*>(img.constScanLine(y)), img.width())) return false;
+    }
+    return true;
+}
+
+QImage Grayscale::compacted(const QImage& img)
+{
+    if(img.format() == QImage::Format_Grayscale8 || !isGrayscale(img)) return img;
+    if(img.format() == QImage::Format_Indexed8) return img.convertToFormat(QImage::Format_Grayscale8);
+
+    // B == G == R, so the blue byte is the gray value, no luminance weighting needed
+    QImage res = ImageBufferPool::pool().acquire(img.size(), QImage::Format_Grayscale8);
+    if(res.isNull()) return img;
+    for(int y = 0; y < img.height(); y++)
+        packRow(reinterpret_cast<const quint32*>(img.constScanLine(y)), res.scanLine(y), img.width());
+    res.setDotsPerMeterX(img.dotsPerMeterX());
+    res.setDotsPerMeterY(img.dotsPerMeterY());
+    return res;
+}
+
+QPixmap Grayscale::toPixmap(const QImage& img)
+{
+    return QPixmap::fromImage(compacted(img), Qt::NoFormatConversion);
+}
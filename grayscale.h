@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QImage>
+#include <QPixmap>
+
+/**
+ * Compact storage for monochrome pages. Scanned manga is usually saved as color JPEG or PNG
+ * even though every pixel has R == G == B, such pages are kept as Format_Grayscale8 instead,
+ * which takes a quarter of the memory. Scaling and orienting keep the 8 bit format,
+ * it is only expanded by QPainter when the page is drawn on screen.
+ */
+class Grayscale
+{
+public:
+    // true for opaque images without color, checks the pixels of 32 bit images
+    static bool isGrayscale(const QImage& img);
+    // the image as Format_Grayscale8 if it has no color, otherwise img itself
+    static QImage compacted(const QImage& img);
+    // QPixmap::fromImage would convert an 8 bit image back to the 32 bit screen format
+    static QPixmap toPixmap(const QImage& img);
+};
@@ -0,0 +1,150 @@
+#include "imagebufferpool.h"
+#include <QBuffer>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <algorithm>
+
+namespace
+{
+    // thumbnails and screen bands churn far less than pages, malloc serves them well enough
+    constexpr qint64 minPooledBytes = 256 * 1024;
+    constexpr int bufferAlignment = 64;
+
+    qint64 sizeClass(qint64 bytes)
+    {
+        // round up to 1/8 steps between powers of two, at most 12.5% is wasted
+        int log = 0;
+        while((qint64(1) << (log + 1)) < bytes) log++;
+        const qint64 step = std::max<qint64>(bufferAlignment, (qint64(1) << log) / 8);
+        return (bytes + step - 1) / step * step;
+    }
+
+    int alignedBytesPerLine(int width, QImage::Format format)
+    {
+        // 32 byte aligned scanlines, so the SIMD kernels never split a load across rows
+        const int depth = QImage::toPixelFormat(format).bitsPerPixel();
+        return (int((qint64(width) * depth + 7) / 8) + 31) & ~31;
+    }
+}
+
+ImageBufferPool& ImageBufferPool::pool()
+{
+    // never destroyed: pixmaps still held by the caches at exit return their buffers here
+    // after function-local statics constructed later would already be gone
+    static ImageBufferPool* pool = new ImageBufferPool;
+    return *pool;
+}
+
+QImage ImageBufferPool::acquire(const QSize& size, QImage::Format format)
+{
+    if(size.isEmpty() || format == QImage::Format_Invalid) return {};
+    const int bytesPerLine = alignedBytesPerLine(size.width(), format);
+    const qint64 bytes = qint64(bytesPerLine) * size.height();
+
+    QMutexLocker lock(&mut);
+    if(maxIdleBytes == 0 || bytes < minPooledBytes)
+    {
+        lock.unlock();
+        return QImage(size, format);
+    }
+
+    const qint64 cls = sizeClass(bytes);
+    stats.acquired++;
+    Buffer* buffer = nullptr;
+    if(auto it = idle.find(cls); it != idle.end() && !it->isEmpty())
+    {
+        buffer = it->takeLast();
+        idleBytes -= buffer->size;
+        stats.reused++;
+    }
+    lock.unlock();
+
+    if(!buffer)
+    {
+        auto data = static_cast<uchar*>(qMallocAligned(size_t(cls), bufferAlignment));
+        if(!data) return {};
+        buffer = new Buffer{data, cls};
+        QMutexLocker statsLock(&mut);
+        stats.allocated++;
+    }
+    return QImage(buffer->data, size.width(), size.height(), bytesPerLine, format, &ImageBufferPool::releaseBuffer, buffer);
+}
+
+QImage ImageBufferPool::decode(const QByteArray& data)
+{
+    QByteArray copy = data;
+    QBuffer buffer(&copy);
+    QImageReader reader(&buffer);
+    return decode(reader);
+}
+
+QImage ImageBufferPool::decode(const QString& path)
+{
+    QImageReader reader(path);
+    return decode(reader);
+}
+
+QImage ImageBufferPool::decode(QImageReader& reader)
+{
+    // the JPEG and PNG plugins write into the passed image if its size and format already match
+    // what they are about to decode, so a pooled buffer prepared from the header is filled in place
+    QImage img;
+    const QSize size = reader.size();
+    const QImage::Format format = reader.imageFormat();
+    if(size.isValid() && format != QImage::Format_Invalid) img = acquire(size, format);
+    if(!reader.read(&img)) return {};
+    return img;
+}
+
+void ImageBufferPool::initialize(qint64 maxIdleBytes)
+{
+    QMutexLocker lock(&mut);
+    this->maxIdleBytes = std::max<qint64>(0, maxIdleBytes);
+    lock.unlock();
+    if(this->maxIdleBytes == 0) trim();
+}
+
+void ImageBufferPool::trim()
+{
+    QHash<qint64, QVector<Buffer*>> freed;
+    {
+        QMutexLocker lock(&mut);
+        freed.swap(idle);
+        idleBytes = 0;
+    }
+    for(const auto& buffers: freed)
+    {
+        for(auto buffer: buffers)
+        {
+            qFreeAligned(buffer->data);
+            delete buffer;
+        }
+    }
+}
+
+ImageBufferPool::Statistics ImageBufferPool::statistics()
+{
+    QMutexLocker lock(&mut);
+    Statistics res = stats;
+    res.idleBytes = idleBytes;
+    return res;
+}
+
+void ImageBufferPool::releaseBuffer(void* info)
+{
+    pool().release(static_cast<Buffer*>(info));
+}
+
+void ImageBufferPool::release(Buffer* buffer)
+{
+    QMutexLocker lock(&mut);
+    if(idleBytes + buffer->size <= maxIdleBytes)
+    {
+        idle[buffer->size].append(buffer);
+        idleBytes += buffer->size;
+        return;
+    }
+    lock.unlock();
+    qFreeAligned(buffer->data);
+    delete buffer;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QVector>
+
+/**
+ * Recycles the pixel buffers of page sized images. Pages of one comic nearly always share their
+ * dimensions, so instead of handing multi-megabyte buffers back to malloc after every decode,
+ * scale or transform they are kept in size classes (steps of 1/8 of a power of two) and reused.
+ * Images from the pool are ordinary QImages that return their buffer when the last copy
+ * (including a QPixmap made from it with QPixmap::fromImage(std::move(img))) goes away.
+ * Small images are allocated normally.
+ */
+class ImageBufferPool
+{
+public:
+    struct Statistics
+    {
+        quint64 acquired = 0;
+        quint64 reused = 0;
+        quint64 allocated = 0;
+        qint64 idleBytes = 0;
+    };
+
+    static ImageBufferPool& pool();
+    // uninitialized pixels, like QImage(size, format)
+    QImage acquire(const QSize& size, QImage::Format format);
+    // decodes into a pooled buffer where the image plugin allows it, like QImage::fromData or QImage(path)
+    QImage decode(const QByteArray& data);
+    QImage decode(const QString& path);
+    // at most maxIdleBytes are kept for reuse, 0 disables pooling
+    void initialize(qint64 maxIdleBytes);
+    // frees all idle buffers
+    void trim();
+    Statistics statistics();
+
+private:
+    struct Buffer
+    {
+        uchar* data = nullptr;
+        qint64 size = 0;
+    };
+    static void releaseBuffer(void* info);
+    QImage decode(class QImageReader& reader);
+    void release(Buffer* buffer);
+    qint64 maxIdleBytes = 0;
+    qint64 idleBytes = 0;
+    QHash<qint64, QVector<Buffer*>> idle;
+    Statistics stats;
+    QMutex mut;
+};
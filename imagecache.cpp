@@ -19,8 +19,23 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "imagecache.h"
 #include <QReadLocker>
 #include <QWriteLocker>
+#include <algorithm>
 #include <QDebug>
+#include "memorygovernor.h"
 
+namespace
+{
+    // grayscale pages are stored at 8 bits per pixel and count as a quarter of a page
+    double pageWeight(const QPixmap& img)
+    {
+        return img.isNull() ? 0.0 : img.depth() / 32.0;
+    }
+
+    qint64 pixmapBytes(const QPixmap& img)
+    {
+        return img.isNull() ? 0 : qint64(img.width()) * img.height() * img.depth() / 8;
+    }
+}
 
 ImageCache& ImageCache::cache()
 {
@@ -45,8 +60,29 @@ void ImageCache::addImage(const QPair<QString, int>& key, const QPixmap& img)
         maintain(); // clear to have space.
     }
 
+    // computed here, on the decoding thread, so the paint event only has to merge two small histograms
+    EdgeColorHistogram edgeColors;
+    if(edgeColorStep > 0) edgeColors = EdgeColorHistogram::fromImage(img.toImage(), edgeColorStep);
+
     QWriteLocker lock(&mut);
-    storage.push_front(imgCacheEntry{key.first, key.second, img});
+    // a page rendered again at another resolution replaces the old rendition
+    storage.erase(std::remove_if(storage.begin(), storage.end(), [&key](const imgCacheEntry& s) {
+        return s.id == key.first && s.page == key.second;
+    }), storage.end());
+    storage.push_front(imgCacheEntry{key.first, key.second, img, edgeColors});
+    lock.unlock();
+    MemoryGovernor::governor().rebalance();
+}
+
+EdgeColorHistogram ImageCache::getEdgeColors(const QPair<QString, int>& key)
+{
+    QReadLocker lock(&this->mut);
+    for(const auto& s: std::as_const(storage)) {
+        if(s.id == key.first && s.page == key.second) {
+            return s.edgeColors;
+        }
+    }
+    return {};
 }
 
 int ImageCache::hasKey(const QPair<QString, int>& key)
@@ -65,13 +101,49 @@ void ImageCache::initialize(int maxCount)
     this->maxCount = maxCount;
 }
 
+void ImageCache::setEdgeColorStep(int step)
+{
+    this->edgeColorStep = step;
+}
+
+qint64 ImageCache::byteSize()
+{
+    QReadLocker lock(&this->mut);
+    qint64 res = 0;
+    for(const auto& s: std::as_const(storage)) res += pixmapBytes(s.data);
+    return res;
+}
+
+void ImageCache::shrinkTo(qint64 bytes)
+{
+    QWriteLocker lock(&mut);
+    qint64 size = 0;
+    for(const auto& s: std::as_const(storage)) size += pixmapBytes(s.data);
+    while(storage.size() > 2 && size > bytes)
+    {
+        size -= pixmapBytes(storage.back().data);
+        storage.pop_back();
+    }
+}
+
+void ImageCache::retain(const QList<QPair<QString, int>>& keys)
+{
+    QWriteLocker lock(&mut);
+    storage.erase(std::remove_if(storage.begin(), storage.end(), [&](const imgCacheEntry& s) {
+        return !keys.contains(QPair{s.id, s.page});
+    }), storage.end());
+}
+
 void ImageCache::maintain()
 {
     QWriteLocker lock(&mut);
-    if(storage.size() > maxCount)
+    double weight = 0;
+    for(const auto& s: std::as_const(storage)) weight += pageWeight(s.data);
+    if(weight > maxCount)
     {
-        while(storage.size() > (maxCount * 2) / 3)
+        while(!storage.isEmpty() && weight > (maxCount * 2) / 3)
         {
+            weight -= pageWeight(storage.back().data);
             storage.back().data = QPixmap{};
             storage.pop_back();
         }
@@ -100,9 +172,20 @@ QPixmap ThumbCache::getPixmap(const QPair<QString, int>& key)
 void ThumbCache::addImage(const QPair<QString, int>& key, QPixmap img)
 {
     mut.lock();
-    storage[key] = img;
-    keys.push_back(key);
+    if(auto it = storage.find(key); it != storage.end())
+    {
+        bytes -= pixmapBytes(*it);
+        *it = img;
+    }
+    else
+    {
+        storage.insert(key, img);
+        keys.push_back(key);
+    }
+    bytes += pixmapBytes(img);
+    maintain();
     mut.unlock();
+    MemoryGovernor::governor().rebalance();
 }
 
 bool ThumbCache::hasKey(const QPair<QString, int>& key)
@@ -124,8 +207,24 @@ void ThumbCache::maintain()
     {
         while(keys.size() > (maxCount * 2) / 3)
         {
-            storage.remove(keys.front());
+            bytes -= pixmapBytes(storage.take(keys.front()));
             keys.pop_front();
         }
     }
 }
+
+qint64 ThumbCache::byteSize()
+{
+    QMutexLocker lock(&mut);
+    return bytes;
+}
+
+void ThumbCache::shrinkTo(qint64 bytes)
+{
+    QMutexLocker lock(&mut);
+    while(!keys.isEmpty() && this->bytes > bytes)
+    {
+        this->bytes -= pixmapBytes(storage.take(keys.front()));
+        keys.pop_front();
+    }
+}
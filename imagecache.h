@@ -24,12 +24,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <QMutex>
 #include <QReadWriteLock>
 #include <QMap>
+#include "edgecolor.h"
 
 struct imgCacheEntry
 {
     QString id;
     int page = -1;
     QPixmap data;
+    EdgeColorHistogram edgeColors;
 };
 
 class ImageCache
@@ -39,11 +41,21 @@ public:
     QPixmap getImage(const QPair<QString, int>& key);
     void addImage(const QPair<QString, int>& key, const QPixmap& img);
     int hasKey(const QPair<QString, int>& key);
+    // maxCount is in 32 bit pages, grayscale pages take a quarter of that
     void initialize(int maxCount);
+    EdgeColorHistogram getEdgeColors(const QPair<QString, int>& key);
+    // step 0 disables computing edge histograms on insertion
+    void setEdgeColorStep(int step);
+    qint64 byteSize();
+    // drops the oldest pages, but always keeps the two newest ones
+    void shrinkTo(qint64 bytes);
+    // drops every page but the given ones
+    void retain(const QList<QPair<QString, int>>& keys);
 
 private:
     void maintain();
     int maxCount = 0;
+    int edgeColorStep = 0;
     QVector<imgCacheEntry> storage;
     imgCacheEntry m_curWrtKey{};
     QReadWriteLock mut { QReadWriteLock::Recursive };
@@ -58,10 +70,13 @@ public:
     bool hasKey(const QPair<QString, int>& key);
     void initialize(int maxCount);
     void maintain();
+    qint64 byteSize();
+    void shrinkTo(qint64 bytes);
     QList<QPair<QString, int>> keys;
 
 private:
     int maxCount = 0;
+    qint64 bytes = 0;
     QMap<QPair<QString, int>, QPixmap> storage;
     QMutex mut;
 };
@@ -3,6 +3,9 @@
 #include <qdebug.h>
 #include "comicsource.h"
 #include "imagecache.h"
+#include "encodedcache.h"
+#include "memorygovernor.h"
+#include <algorithm>
 
 ImagePreloader::ImagePreloader(int count, bool enabled, QObject* parent) :
     QThread{parent}, count(count), enabled(enabled)
@@ -16,8 +19,10 @@ void ImagePreloader::preloadPages(ComicSource* src, int currPage)
     this->workMutex.lock();
     this->m_comicSource = src;
     this->pageNums.clear();
+    this->readAheadFrom = -1;
     if(src)
     {
+        this->readAheadFrom = currPage;
         int maxPageCount = src->getPageCount();
         for(int i = currPage - 1 - count; i <= currPage - 1 + count; i++)
             if(i >= 0 && i < maxPageCount) pageNums.enqueue(i);
@@ -33,6 +38,7 @@ void ImagePreloader::stopCurrentWork()
     this->stopFlag = true;
     this->waitMutex.lock();
     this->pageNums.clear();
+    this->readAheadFrom = -1;
     this->waitCondition.wakeAll();
     this->waitMutex.unlock();
 }
@@ -56,6 +62,7 @@ void ImagePreloader::run()
             if(page == -1) break;
             preloadPage(page);
         }
+        readAhead();
 
         waitCondition.wait(&waitMutex);
 
@@ -65,6 +72,7 @@ void ImagePreloader::run()
             if(page == -1) break;
             preloadPage(page);
         }
+        readAhead();
 
         waitMutex.unlock();
     }
@@ -72,7 +80,8 @@ void ImagePreloader::run()
 
 void ImagePreloader::preloadPage(int n)
 {
-    if(!enabled) return;
+    // prefetching is the first thing to go when memory runs short
+    if(!enabled || !MemoryGovernor::governor().allowPrefetch()) return;
     int limit = n + 3;
     for(; n <= limit; n++){
         if(m_comicSource->isValidPage(n)){
@@ -87,6 +96,21 @@ void ImagePreloader::preloadPage(int n)
     }
 }
 
+void ImagePreloader::readAhead()
+{
+    workMutex.lock();
+    const int from = readAheadFrom;
+    readAheadFrom = -1;
+    workMutex.unlock();
+    if(!m_comicSource || from < 0) return;
+
+    // pages that fall out of ImageCache later only cost a decode
+    const int last = std::min(m_comicSource->getPageCount(), from + EncodedCache::cache().readAheadCount());
+    for(int i = from; i < last && !(stopFlag || exitFlag); i++)
+    {
+        if(!MemoryGovernor::governor().allowPrefetch() || !m_comicSource->prefetchPageData(i)) break;
+    }
+}
 
 int ImagePreloader::checkQueue()
 {
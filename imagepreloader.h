@@ -19,6 +19,8 @@ public:
 
 private:
     void preloadPage(int n);
+    // after the pages around the current one are decoded, the compressed files further ahead are read
+    void readAhead();
     const int count;
     std::atomic_bool stopFlag = false;
     ComicSource* m_comicSource = nullptr;
@@ -28,5 +30,6 @@ private:
     int checkQueue();
     QWaitCondition waitCondition;
     QQueue<int> pageNums;
+    int readAheadFrom = -1;
     std::atomic_bool exitFlag = false;
 };
@@ -0,0 +1,418 @@
+#include "imagescaler.h"
+#include "imagebufferpool.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QCOMIX_SCALER_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Filter taps for one axis: destination pixel i is the weighted sum of
+    // count[i] source pixels starting at start[i], weights are stored with a stride of taps.
+    struct Contributions
+    {
+        int taps = 0;
+        QVector<int> start;
+        QVector<int> count;
+        QVector<float> weights;
+    };
+
+    double lanczos3(double x)
+    {
+        x = std::abs(x);
+        if(x < 1e-8) return 1.0;
+        if(x >= 3.0) return 0.0;
+        const double px = M_PI * x;
+        return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+    }
+
+    Contributions computeContributions(int srcLen, int dstLen)
+    {
+        Contributions c;
+        const double scale = double(srcLen) / dstLen;
+        c.start.resize(dstLen);
+        c.count.resize(dstLen);
+
+        if(scale >= 2.0)
+        {
+            // area average: each destination pixel covers [i * scale, (i + 1) * scale) of the source
+            c.taps = int(std::ceil(scale)) + 1;
+            c.weights.fill(0.0f, dstLen * c.taps);
+            for(int i = 0; i < dstLen; i++)
+            {
+                const double lo = i * scale;
+                const double hi = std::min(double(srcLen), (i + 1) * scale);
+                const int s = int(lo);
+                const int e = std::min(srcLen, int(std::ceil(hi)));
+                c.start[i] = s;
+                c.count[i] = e - s;
+                for(int j = s; j < e; j++)
+                    c.weights[i * c.taps + j - s] = float((std::min(hi, j + 1.0) - std::max(lo, double(j))) / (hi - lo));
+            }
+        }
+        else
+        {
+            const double support = 3.0 * scale;
+            c.taps = int(std::ceil(2.0 * support)) + 2;
+            c.weights.fill(0.0f, dstLen * c.taps);
+            for(int i = 0; i < dstLen; i++)
+            {
+                const double center = (i + 0.5) * scale;
+                const int s = std::max(0, int(std::floor(center - support)));
+                const int e = std::min(srcLen, int(std::ceil(center + support)));
+                double sum = 0;
+                for(int j = s; j < e; j++) sum += lanczos3((j + 0.5 - center) / scale);
+                c.start[i] = s;
+                c.count[i] = e - s;
+                for(int j = s; j < e; j++)
+                    c.weights[i * c.taps + j - s] = float(lanczos3((j + 0.5 - center) / scale) / sum);
+            }
+        }
+        return c;
+    }
+
+    // Kernels. A horizontally filtered row holds 4 floats per pixel in memory order (B, G, R, A),
+    // or a single float per pixel for Format_Grayscale8.
+    using HorizontalFn = void (*)(const quint32* src, float* dst, const Contributions& cx, int dstW);
+    using HorizontalGrayFn = void (*)(const uchar* src, float* dst, const Contributions& cx, int dstW);
+    using AccumulateFn = void (*)(float* acc, const float* row, float weight, int len);
+    using PackFn = void (*)(const float* acc, quint32* dst, int dstW, bool premultiplied);
+    using PackGrayFn = void (*)(const float* acc, uchar* dst, int dstW);
+
+    void horizontalScalar(const quint32* src, float* dst, const Contributions& cx, int dstW)
+    {
+        for(int x = 0; x < dstW; x++)
+        {
+            const quint32* p = src + cx.start[x];
+            const float* w = cx.weights.constData() + x * cx.taps;
+            float b = 0, g = 0, r = 0, a = 0;
+            for(int k = 0; k < cx.count[x]; k++)
+            {
+                b += w[k] * float(p[k] & 0xFF);
+                g += w[k] * float((p[k] >> 8) & 0xFF);
+                r += w[k] * float((p[k] >> 16) & 0xFF);
+                a += w[k] * float(p[k] >> 24);
+            }
+            dst[4 * x] = b;
+            dst[4 * x + 1] = g;
+            dst[4 * x + 2] = r;
+            dst[4 * x + 3] = a;
+        }
+    }
+
+    void horizontalGrayScalar(const uchar* src, float* dst, const Contributions& cx, int dstW)
+    {
+        for(int x = 0; x < dstW; x++)
+        {
+            const uchar* p = src + cx.start[x];
+            const float* w = cx.weights.constData() + x * cx.taps;
+            float v = 0;
+            for(int k = 0; k < cx.count[x]; k++) v += w[k] * float(p[k]);
+            dst[x] = v;
+        }
+    }
+
+    void accumulateScalar(float* acc, const float* row, float weight, int len)
+    {
+        for(int i = 0; i < len; i++) acc[i] += weight * row[i];
+    }
+
+    void packScalar(const float* acc, quint32* dst, int dstW, bool premultiplied)
+    {
+        for(int x = 0; x < dstW; x++)
+        {
+            const float a = std::clamp(acc[4 * x + 3], 0.0f, 255.0f);
+            const float limit = premultiplied ? a : 255.0f;
+            quint32 px = quint32(std::lround(a)) << 24;
+            for(int ch = 0; ch < 3; ch++)
+                px |= quint32(std::lround(std::clamp(acc[4 * x + ch], 0.0f, limit))) << (8 * ch);
+            dst[x] = px;
+        }
+    }
+
+    void packGrayScalar(const float* acc, uchar* dst, int dstW)
+    {
+        for(int x = 0; x < dstW; x++) dst[x] = uchar(std::lround(std::clamp(acc[x], 0.0f, 255.0f)));
+    }
+
+#ifdef QCOMIX_SCALER_X86
+    __attribute__((target("sse4.1"))) void horizontalSse41(const quint32* src, float* dst, const Contributions& cx, int dstW)
+    {
+        for(int x = 0; x < dstW; x++)
+        {
+            const quint32* p = src + cx.start[x];
+            const float* w = cx.weights.constData() + x * cx.taps;
+            __m128 acc = _mm_setzero_ps();
+            for(int k = 0; k < cx.count[x]; k++)
+            {
+                const __m128 px = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(int(p[k]))));
+                acc = _mm_add_ps(acc, _mm_mul_ps(px, _mm_set1_ps(w[k])));
+            }
+            _mm_storeu_ps(dst + 4 * x, acc);
+        }
+    }
+
+    __attribute__((target("sse4.1"))) void horizontalGraySse41(const uchar* src, float* dst, const Contributions& cx, int dstW)
+    {
+        for(int x = 0; x < dstW; x++)
+        {
+            const uchar* p = src + cx.start[x];
+            const float* w = cx.weights.constData() + x * cx.taps;
+            const int count = cx.count[x];
+            // four taps per iteration, the weight rows are taps long so w[k + 3] is always there
+            __m128 acc = _mm_setzero_ps();
+            int k = 0;
+            for(; k + 4 <= count; k += 4)
+            {
+                int bytes;
+                std::memcpy(&bytes, p + k, 4);
+                const __m128 px = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)));
+                acc = _mm_add_ps(acc, _mm_mul_ps(px, _mm_loadu_ps(w + k)));
+            }
+            acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+            acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+            float v = _mm_cvtss_f32(acc);
+            for(; k < count; k++) v += w[k] * float(p[k]);
+            dst[x] = v;
+        }
+    }
+
+    __attribute__((target("sse4.1"))) void accumulateSse41(float* acc, const float* row, float weight, int len)
+    {
+        const __m128 w = _mm_set1_ps(weight);
+        int i = 0;
+        for(; i + 4 <= len; i += 4)
+            _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(w, _mm_loadu_ps(row + i))));
+        for(; i < len; i++) acc[i] += weight * row[i];
+    }
+
+    __attribute__((target("sse4.1"))) void packSse41(const float* acc, quint32* dst, int dstW, bool premultiplied)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 max = _mm_set1_ps(255.0f);
+        for(int x = 0; x < dstW; x++)
+        {
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(acc + 4 * x), zero), max);
+            // Lanczos overshoot must not push a premultiplied channel above its alpha
+            if(premultiplied) v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+            __m128i i32 = _mm_cvtps_epi32(v);
+            __m128i i16 = _mm_packus_epi32(i32, i32);
+            dst[x] = quint32(_mm_cvtsi128_si32(_mm_packus_epi16(i16, i16)));
+        }
+    }
+
+    __attribute__((target("sse4.1"))) void packGraySse41(const float* acc, uchar* dst, int dstW)
+    {
+        int x = 0;
+        for(; x + 16 <= dstW; x += 16)
+        {
+            // cvtps rounds to nearest, the saturating packs clamp to 0..255
+            const __m128i a = _mm_packs_epi32(_mm_cvtps_epi32(_mm_loadu_ps(acc + x)), _mm_cvtps_epi32(_mm_loadu_ps(acc + x + 4)));
+            const __m128i b = _mm_packs_epi32(_mm_cvtps_epi32(_mm_loadu_ps(acc + x + 8)), _mm_cvtps_epi32(_mm_loadu_ps(acc + x + 12)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(a, b));
+        }
+        packGrayScalar(acc + x, dst + x, dstW - x);
+    }
+
+    __attribute__((target("avx2,fma"))) void horizontalAvx2(const quint32* src, float* dst, const Contributions& cx, int dstW)
+    {
+        for(int x = 0; x < dstW; x++)
+        {
+            const quint32* p = src + cx.start[x];
+            const float* w = cx.weights.constData() + x * cx.taps;
+            const int count = cx.count[x];
+            __m256 acc = _mm256_setzero_ps();
+            int k = 0;
+            // two source pixels per iteration, one in each 128 bit lane
+            for(; k + 2 <= count; k += 2)
+            {
+                const __m256 px = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + k))));
+                const __m256 wk = _mm256_set_m128(_mm_set1_ps(w[k + 1]), _mm_set1_ps(w[k]));
+                acc = _mm256_fmadd_ps(px, wk, acc);
+            }
+            __m128 res = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+            if(k < count)
+            {
+                const __m128 px = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(int(p[k]))));
+                res = _mm_fmadd_ps(px, _mm_set1_ps(w[k]), res);
+            }
+            _mm_storeu_ps(dst + 4 * x, res);
+        }
+    }
+
+    __attribute__((target("avx2,fma"))) void accumulateAvx2(float* acc, const float* row, float weight, int len)
+    {
+        const __m256 w = _mm256_set1_ps(weight);
+        int i = 0;
+        for(; i + 8 <= len; i += 8)
+            _mm256_storeu_ps(acc + i, _mm256_fmadd_ps(w, _mm256_loadu_ps(row + i), _mm256_loadu_ps(acc + i)));
+        for(; i < len; i++) acc[i] += weight * row[i];
+    }
+#endif
+
+    struct Kernels
+    {
+        HorizontalFn horizontal = horizontalScalar;
+        HorizontalGrayFn horizontalGray = horizontalGrayScalar;
+        AccumulateFn accumulate = accumulateScalar;
+        PackFn pack = packScalar;
+        PackGrayFn packGray = packGrayScalar;
+    };
+
+    const Kernels& kernels()
+    {
+        static const Kernels k = [] {
+            Kernels res;
+#ifdef QCOMIX_SCALER_X86
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("sse4.1"))
+            {
+                res.horizontal = horizontalSse41;
+                res.horizontalGray = horizontalGraySse41;
+                res.accumulate = accumulateSse41;
+                res.pack = packSse41;
+                res.packGray = packGraySse41;
+            }
+            if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            {
+                res.horizontal = horizontalAvx2;
+                res.accumulate = accumulateAvx2;
+            }
+#endif
+            return res;
+        }();
+        return k;
+    }
+
+    struct ScaleJob
+    {
+        const uchar* srcBits = nullptr;
+        int srcStride = 0;
+        uchar* dstBits = nullptr;
+        int dstStride = 0;
+        int dstW = 0;
+        bool premultiplied = false;
+        bool gray = false;
+        Contributions cx;
+        Contributions cy;
+    };
+
+    void scaleBand(const ScaleJob& job, int y0, int y1)
+    {
+        const Kernels& k = kernels();
+        const int rowLen = (job.gray ? 1 : 4) * job.dstW;
+
+        // horizontally filtered source rows live in a ring indexed by sy % taps, each output row
+        // only needs the last taps rows so every source row is filtered once per band
+        const int ringRows = job.cy.taps;
+        std::vector<float> ring(size_t(ringRows) * rowLen);
+        std::vector<float> acc(rowLen);
+        int filteredUpTo = job.cy.start[y0];
+
+        for(int y = y0; y < y1; y++)
+        {
+            const int start = job.cy.start[y];
+            const int end = start + job.cy.count[y];
+            for(int sy = std::max(filteredUpTo, start); sy < end; sy++)
+            {
+                float* row = ring.data() + size_t(sy % ringRows) * rowLen;
+                if(job.gray)
+                    k.horizontalGray(job.srcBits + sy * job.srcStride, row, job.cx, job.dstW);
+                else
+                    k.horizontal(reinterpret_cast<const quint32*>(job.srcBits + sy * job.srcStride), row, job.cx, job.dstW);
+            }
+            filteredUpTo = std::max(filteredUpTo, end);
+
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            const float* w = job.cy.weights.constData() + y * job.cy.taps;
+            for(int t = 0; t < job.cy.count[y]; t++)
+                k.accumulate(acc.data(), ring.data() + size_t((start + t) % ringRows) * rowLen, w[t], rowLen);
+            if(job.gray)
+                k.packGray(acc.data(), job.dstBits + y * job.dstStride, job.dstW);
+            else
+                k.pack(acc.data(), reinterpret_cast<quint32*>(job.dstBits + y * job.dstStride), job.dstW, job.premultiplied);
+        }
+    }
+
+    QThreadPool& scalerPool()
+    {
+        // separate from the global pool, whose threads may be the ones waiting on a scale
+        static QThreadPool pool;
+        return pool;
+    }
+}
+
+QImage ImageScaler::scaled(const QImage& img, const QSize& size, Qt::TransformationMode mode)
+{
+    if(img.isNull() || size.isEmpty()) return {};
+    if(img.size() == size) return img;
+    if(mode == Qt::FastTransformation || size.width() > img.width() || size.height() > img.height())
+        return img.scaled(size, Qt::IgnoreAspectRatio, mode);
+
+    // grayscale pages are filtered on their single channel and stay 8 bit
+    QImage src = img;
+    if(src.format() != QImage::Format_RGB32 && src.format() != QImage::Format_ARGB32_Premultiplied && src.format() != QImage::Format_Grayscale8)
+        src = src.convertToFormat(src.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    QImage dst = ImageBufferPool::pool().acquire(size, src.format());
+    if(dst.isNull()) return {};
+
+    ScaleJob job;
+    job.srcBits = src.constBits();
+    job.srcStride = src.bytesPerLine();
+    job.dstBits = dst.bits();
+    job.dstStride = dst.bytesPerLine();
+    job.dstW = size.width();
+    job.premultiplied = src.format() == QImage::Format_ARGB32_Premultiplied;
+    job.gray = src.format() == QImage::Format_Grayscale8;
+    job.cx = computeContributions(src.width(), size.width());
+    job.cy = computeContributions(src.height(), size.height());
+
+    const int dstH = size.height();
+    const int threads = qint64(src.width()) * src.height() < (1 << 20) ? 1 : std::max(1, QThread::idealThreadCount());
+    const int bandRows = std::max(16, dstH / (threads * 4));
+    const int bandCount = (dstH + bandRows - 1) / bandRows;
+
+    std::atomic<int> nextBand{0};
+    auto work = [&] {
+        for(int b = nextBand++; b < bandCount; b = nextBand++)
+            scaleBand(job, b * bandRows, std::min(dstH, (b + 1) * bandRows));
+    };
+    // the calling thread takes bands too, so this finishes even if the pool is busy
+    QVector<QFuture<void>> helpers;
+    for(int i = 1; i < std::min(threads, bandCount); i++) helpers.append(QtConcurrent::run(&scalerPool(), work));
+    work();
+    for(auto& f: helpers) f.waitForFinished();
+
+    return dst;
+}
+
+QPixmap ImageScaler::scaled(const QPixmap& pix, int w, int h, Qt::AspectRatioMode aspectMode, Qt::TransformationMode mode)
+{
+    if(pix.isNull()) return {};
+    const QSize size = pix.size().scaled(w, h, aspectMode);
+    if(mode == Qt::FastTransformation || size.width() > pix.width() || size.height() > pix.height())
+        return pix.scaled(size, Qt::IgnoreAspectRatio, mode);
+    return QPixmap::fromImage(scaled(pix.toImage(), size, mode), Qt::NoFormatConversion);
+}
+
+QPixmap ImageScaler::scaledToWidth(const QPixmap& pix, int w, Qt::TransformationMode mode)
+{
+    if(pix.isNull() || w <= 0) return {};
+    return scaled(pix, w, std::max(1, qRound(double(pix.height()) * w / pix.width())), Qt::IgnoreAspectRatio, mode);
+}
+
+QPixmap ImageScaler::scaledToHeight(const QPixmap& pix, int h, Qt::TransformationMode mode)
+{
+    if(pix.isNull() || h <= 0) return {};
+    return scaled(pix, std::max(1, qRound(double(pix.width()) * h / pix.height())), h, Qt::IgnoreAspectRatio, mode);
+}
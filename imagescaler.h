@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QImage>
+#include <QPixmap>
+
+/**
+ * Multithreaded downscaler used instead of QPixmap::scaled for fitting pages and thumbnails.
+ * Reductions by a factor of 2 or more use an area average, smaller ones a separable Lanczos3 filter.
+ * Output rows are processed in bands on all cores, with SSE4.1/AVX2 kernels picked at runtime.
+ * Format_Grayscale8 images are scaled on their single channel and stay 8 bit.
+ * Upscaling and Qt::FastTransformation are passed on to Qt.
+ */
+class ImageScaler
+{
+public:
+    static QImage scaled(const QImage& img, const QSize& size, Qt::TransformationMode mode = Qt::SmoothTransformation);
+    static QPixmap scaled(const QPixmap& pix, int w, int h, Qt::AspectRatioMode aspectMode, Qt::TransformationMode mode = Qt::SmoothTransformation);
+    static QPixmap scaledToWidth(const QPixmap& pix, int w, Qt::TransformationMode mode = Qt::SmoothTransformation);
+    static QPixmap scaledToHeight(const QPixmap& pix, int h, Qt::TransformationMode mode = Qt::SmoothTransformation);
+};
@@ -0,0 +1,201 @@
+#include "imagetransform.h"
+#include "imagebufferpool.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr int tileSize = 64;
+
+    int normalizedDegree(int rotationDegree)
+    {
+        return ((rotationDegree % 360) + 360) % 360;
+    }
+
+    // Source coordinate of destination pixel (x, y): sx = x0 + xx * x + xy * y, sy = y0 + yx * x + yy * y
+    struct Mapping
+    {
+        int x0 = 0, xx = 1, xy = 0;
+        int y0 = 0, yx = 0, yy = 1;
+    };
+
+    Mapping computeMapping(int w, int h, int degree, bool hFlip, bool vFlip)
+    {
+        // destination -> mirrored image
+        Mapping m;
+        switch(degree)
+        {
+            case 90:
+                m = {0, 0, 1, h - 1, -1, 0};
+                break;
+            case 180:
+                m = {w - 1, -1, 0, h - 1, 0, -1};
+                break;
+            case 270:
+                m = {w - 1, 0, -1, 0, 1, 0};
+                break;
+            default:
+                break;
+        }
+        // mirrored image -> source
+        if(hFlip) m = {w - 1 - m.x0, -m.xx, -m.xy, m.y0, m.yx, m.yy};
+        if(vFlip) m = {m.x0, m.xx, m.xy, h - 1 - m.y0, -m.yx, -m.yy};
+        return m;
+    }
+
+    template<typename T>
+    void orientTile(const uchar* srcBits, qptrdiff srcStride, uchar* dstBits, qptrdiff dstStride, const Mapping& m, int tx0, int ty0, int tx1, int ty1)
+    {
+        // step through the source when moving one pixel right in the destination
+        const qptrdiff step = m.xx * qptrdiff(sizeof(T)) + m.yx * srcStride;
+        for(int y = ty0; y < ty1; y++)
+        {
+            const uchar* s = srcBits + qptrdiff(m.y0 + m.yx * tx0 + m.yy * y) * srcStride + qptrdiff(m.x0 + m.xx * tx0 + m.xy * y) * qptrdiff(sizeof(T));
+            T* d = reinterpret_cast<T*>(dstBits + y * dstStride) + tx0;
+            if(step == qptrdiff(sizeof(T)))
+            {
+                std::memcpy(d, s, size_t(tx1 - tx0) * sizeof(T));
+            }
+            else if(step == -qptrdiff(sizeof(T)))
+            {
+                const T* rs = reinterpret_cast<const T*>(s);
+                std::reverse_copy(rs - (tx1 - tx0 - 1), rs + 1, d);
+            }
+            else
+            {
+                for(int x = tx0; x < tx1; x++, s += step) *d++ = *reinterpret_cast<const T*>(s);
+            }
+        }
+    }
+
+#ifdef __SSE2__
+    // 32 bit rotations by 90/270 degrees: move 4x4 blocks with an in-register transpose
+    void orientTileTransposed32(const uchar* srcBits, qptrdiff srcStride, uchar* dstBits, qptrdiff dstStride, const Mapping& m, int tx0, int ty0, int tx1, int ty1)
+    {
+        const int bx1 = tx0 + ((tx1 - tx0) & ~3);
+        const int by1 = ty0 + ((ty1 - ty0) & ~3);
+        for(int y = ty0; y < by1; y += 4)
+        {
+            // destination rows y..y+3 read source columns sx(y)..sx(y+3), which run along m.xy
+            const int colMin = m.x0 + m.xy * (m.xy > 0 ? y : y + 3);
+            for(int x = tx0; x < bx1; x += 4)
+            {
+                __m128i r[4];
+                for(int i = 0; i < 4; i++)
+                {
+                    const int sy = m.y0 + m.yx * (x + i);
+                    r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(reinterpret_cast<const quint32*>(srcBits + sy * srcStride) + colMin));
+                }
+                // t[j] = (r0[j], r1[j], r2[j], r3[j]) holds source column colMin + j
+                const __m128i a = _mm_unpacklo_epi32(r[0], r[1]);
+                const __m128i b = _mm_unpacklo_epi32(r[2], r[3]);
+                const __m128i c = _mm_unpackhi_epi32(r[0], r[1]);
+                const __m128i d = _mm_unpackhi_epi32(r[2], r[3]);
+                const __m128i t[4] = {_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b), _mm_unpacklo_epi64(c, d), _mm_unpackhi_epi64(c, d)};
+                for(int k = 0; k < 4; k++)
+                {
+                    quint32* dst = reinterpret_cast<quint32*>(dstBits + (y + k) * dstStride) + x;
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), t[m.xy > 0 ? k : 3 - k]);
+                }
+            }
+        }
+        // ragged right and bottom edges
+        if(bx1 < tx1) orientTile<quint32>(srcBits, srcStride, dstBits, dstStride, m, bx1, ty0, tx1, by1);
+        if(by1 < ty1) orientTile<quint32>(srcBits, srcStride, dstBits, dstStride, m, tx0, by1, tx1, ty1);
+    }
+#endif
+
+    template<typename T>
+    void orientPixels(const QImage& src, QImage& dst, const Mapping& m)
+    {
+        const uchar* srcBits = src.constBits();
+        const qptrdiff srcStride = src.bytesPerLine();
+        uchar* dstBits = dst.bits();
+        const qptrdiff dstStride = dst.bytesPerLine();
+        const int w = dst.width();
+        const int h = dst.height();
+        for(int ty = 0; ty < h; ty += tileSize)
+        {
+            for(int tx = 0; tx < w; tx += tileSize)
+            {
+                const int tx1 = std::min(w, tx + tileSize);
+                const int ty1 = std::min(h, ty + tileSize);
+#ifdef __SSE2__
+                if constexpr(sizeof(T) == 4)
+                {
+                    if(m.xx == 0)
+                    {
+                        orientTileTransposed32(srcBits, srcStride, dstBits, dstStride, m, tx, ty, tx1, ty1);
+                        continue;
+                    }
+                }
+#endif
+                orientTile<T>(srcBits, srcStride, dstBits, dstStride, m, tx, ty, tx1, ty1);
+            }
+        }
+    }
+}
+
+bool ImageTransform::isIdentity(int rotationDegree, bool hFlip, bool vFlip)
+{
+    return normalizedDegree(rotationDegree) == 0 && !hFlip && !vFlip;
+}
+
+bool ImageTransform::isRightAngle(int rotationDegree)
+{
+    return normalizedDegree(rotationDegree) % 90 == 0;
+}
+
+QSize ImageTransform::orientedSize(const QSize& size, int rotationDegree)
+{
+    const int degree = normalizedDegree(rotationDegree);
+    return degree == 90 || degree == 270 ? size.transposed() : size;
+}
+
+QImage ImageTransform::oriented(const QImage& img, int rotationDegree, bool hFlip, bool vFlip)
+{
+    if(!isRightAngle(rotationDegree)) return {};
+    if(img.isNull() || isIdentity(rotationDegree, hFlip, vFlip)) return img;
+
+    QImage src = img;
+    const int depth = src.depth();
+    if(depth != 8 && depth != 16 && depth != 32 && depth != 64)
+        src = src.convertToFormat(src.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+
+    const int degree = normalizedDegree(rotationDegree);
+    QImage dst = ImageBufferPool::pool().acquire(orientedSize(src.size(), degree), src.format());
+    if(dst.isNull()) return {};
+    dst.setColorTable(src.colorTable());
+    if(degree == 90 || degree == 270)
+    {
+        dst.setDotsPerMeterX(src.dotsPerMeterY());
+        dst.setDotsPerMeterY(src.dotsPerMeterX());
+    }
+    else
+    {
+        dst.setDotsPerMeterX(src.dotsPerMeterX());
+        dst.setDotsPerMeterY(src.dotsPerMeterY());
+    }
+
+    const Mapping m = computeMapping(src.width(), src.height(), degree, hFlip, vFlip);
+    switch(src.depth())
+    {
+        case 8:
+            orientPixels<quint8>(src, dst, m);
+            break;
+        case 16:
+            orientPixels<quint16>(src, dst, m);
+            break;
+        case 32:
+            orientPixels<quint32>(src, dst, m);
+            break;
+        default:
+            orientPixels<quint64>(src, dst, m);
+            break;
+    }
+    return dst;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QImage>
+
+/**
+ * Exact right angle rotations and mirroring without going through QTransform.
+ * The result matches QImage::transformed(QTransform().rotate(degree).scale(hFlip ? -1 : 1, vFlip ? -1 : 1)),
+ * i.e. the image is mirrored first and then rotated clockwise.
+ * Pixels are moved in cache sized tiles and keep the source format, so no conversion or
+ * intermediate copy is made.
+ */
+class ImageTransform
+{
+public:
+    static bool isIdentity(int rotationDegree, bool hFlip, bool vFlip);
+    static bool isRightAngle(int rotationDegree);
+    static QSize orientedSize(const QSize& size, int rotationDegree);
+    // returns img itself (shared, not copied) for the identity and a null image if rotationDegree isn't a multiple of 90
+    static QImage oriented(const QImage& img, int rotationDegree, bool hFlip, bool vFlip);
+};
@@ -22,6 +22,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "comicsource.h"
 #include "comiccreator.h"
 #include "imagecache.h"
+#include "encodedcache.h"
+#include "diskpagecache.h"
+#include "imagebufferpool.h"
+#include "memorygovernor.h"
+#include "naturalsort.h"
+#include "neighborindex.h"
 #include "imagepreloader.h"
 #include "thumbnailer.h"
 #include "ui_mainwindow.h"
@@ -45,7 +51,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <QStandardPaths>
 #include <QStyleFactory>
 #include <QStyledItemDelegate>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
 #include <cmath>
+#include <memory>
 
 QSettings* MainWindow::userProfile = nullptr;
 QSettings* MainWindow::defaultSettings = nullptr;
@@ -169,12 +178,42 @@ void MainWindow::loadSettings()
             qFatal("Invalid theme");
     }
 
+    releaseMemoryInBackground = getOption("releaseMemoryWhenMinimized").toBool();
+    ImageBufferPool::pool().initialize(qint64(getOption("imageBufferPoolLimitMB").toInt()) * 1024 * 1024);
     ImageCache::cache().initialize(getOption("mainImageCacheLimit").toInt());
     ThumbCache::cache().initialize(getOption("thumbnailCacheLimit").toInt());
+    EncodedCache::cache().initialize(qint64(getOption("encodedCacheLimitMB").toInt()) * 1024 * 1024, getOption("encodedReadAheadPages").toInt());
+    auto& governor = MemoryGovernor::governor();
+    governor.registerCache("idle image buffers", MemoryGovernor::Tier::Prefetch,
+                           []() { return ImageBufferPool::pool().statistics().idleBytes; }, [](qint64) { ImageBufferPool::pool().trim(); });
+    governor.registerCache("thumbnails", MemoryGovernor::Tier::Thumbnails,
+                           []() { return ThumbCache::cache().byteSize(); }, [](qint64 bytes) { ThumbCache::cache().shrinkTo(bytes); });
+    governor.registerCache("compressed pages", MemoryGovernor::Tier::Encoded,
+                           []() { return EncodedCache::cache().byteSize(); }, [](qint64 bytes) { EncodedCache::cache().shrinkTo(bytes); });
+    governor.registerCache("decoded pages", MemoryGovernor::Tier::Decoded,
+                           []() { return ImageCache::cache().byteSize(); }, [](qint64 bytes) { ImageCache::cache().shrinkTo(bytes); });
+    governor.initialize(getOption("memoryBudget").toString(), getOption("followMemoryPressure").toBool());
+    DiskPageCache::cache().initialize(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/pages",
+                                      qint64(getOption("diskPageCacheLimitMB").toInt()) * 1024 * 1024);
+    if(getOption("mainViewBackground").toString() == "dynamic" || getOption("thumbBackground").toString() == "dynamic")
+        ImageCache::cache().setEdgeColorStep(getEdgeColorStep());
 
     imagePreloader = new ImagePreloader{getOption("preloadedPageCount").toInt(), getOption("enableNearbyPagePreloader").toBool(), this};
     imagePreloader->start();
 
+    // files being copied or scanned into the folder come in bursts, the rescan waits for a quiet moment
+    comicDirectoryRefreshTimer.setSingleShot(true);
+    comicDirectoryRefreshTimer.setInterval(500);
+    connect(&comicDirectoryRefreshTimer, &QTimer::timeout, this, &MainWindow::refreshComicDirectory);
+    connect(&comicDirectoryWatcher, &QFileSystemWatcher::directoryChanged, [this]() {
+        comicDirectoryRefreshTimer.start();
+    });
+    connect(&comicDirectoryScan, &QFutureWatcher<DirectoryComicSource*>::finished, this, &MainWindow::onComicDirectoryScanned);
+    // the next and previous comic actions stay disabled until the folder of the comic is listed
+    connect(&NeighborIndex::index(), &NeighborIndex::listingReady, this, [this]() {
+        updateUIState();
+    });
+
     this->statusBarTemplate = getOption("statusbarTemplate").toString();
     statusLabel = new KSqueezedTextLabel{};
     statusLabel->setTextElideMode(Qt::ElideRight);
@@ -202,6 +241,7 @@ void MainWindow::loadSettings()
     if(MainWindow::hasOption("shortcutFullscreen")) this->ui->actionFullscreen->setShortcut(QKeySequence{MainWindow::getOption("shortcutFullscreen").toString()});
     if(MainWindow::hasOption("shortcutDouble_page_mode")) this->ui->actionDouble_page_mode->setShortcut(QKeySequence{MainWindow::getOption("shortcutDouble_page_mode").toString()});
     if(MainWindow::hasOption("shortcutManga_mode")) this->ui->actionManga_mode->setShortcut(QKeySequence{MainWindow::getOption("shortcutManga_mode").toString()});
+    if(MainWindow::hasOption("shortcutContinuous_scroll_mode")) this->ui->actionContinuous_scroll_mode->setShortcut(QKeySequence{MainWindow::getOption("shortcutContinuous_scroll_mode").toString()});
     if(MainWindow::hasOption("shortcutBest_fit_mode")) this->ui->actionBest_fit_mode->setShortcut(QKeySequence{MainWindow::getOption("shortcutBest_fit_mode").toString()});
     if(MainWindow::hasOption("shortcutFit_width_mode")) this->ui->actionFit_width_mode->setShortcut(QKeySequence{MainWindow::getOption("shortcutFit_width_mode").toString()});
     if(MainWindow::hasOption("shortcutFit_height_mode")) this->ui->actionFit_height_mode->setShortcut(QKeySequence{MainWindow::getOption("shortcutFit_height_mode").toString()});
@@ -659,77 +699,14 @@ bool MainWindow::hasOption(const QString& key)
 
 QColor MainWindow::getMostCommonEdgeColor(const QImage& left_img, const QImage& right_img)
 {
-    bool fast = MainWindow::getOption("fasterDynamicBackgroundDetection").toBool();
-    const int step = fast ? 4 : 1;
-
-    QMap<QRgb, int> colorCountMap;
-
-    auto left_im_w = left_img.width();
-    auto left_im_h = left_img.height();
-
-    auto right_im_w = right_img.width();
-    auto right_im_h = right_img.height();
-
-    // Left image - left side
-    if(left_im_w > 0)
-    {
-        for(int i = 0; i < left_im_h; i += step) colorCountMap[left_img.pixel(0, i)]++;
-    }
-
-    // Left image - top
-    if(left_im_h > 0)
-    {
-        for(int i = 0; i < left_im_w; i += step) colorCountMap[left_img.pixel(i, 0)]++;
-    }
-
-    // Left image - bottom
-    if(left_im_h > 0)
-    {
-        for(int i = 0; i < left_im_w; i += step) colorCountMap[left_img.pixel(i, left_im_h - 1)]++;
-    }
-
-    // Left image - right side
-    if(left_im_w > 0 && left_img.isNull())
-    {
-        for(int i = 0; i < left_im_h; i += step) colorCountMap[left_img.pixel(left_im_w - 1, i)]++;
-    }
-
-    if(!right_img.isNull())
-    {
-        // Right image - top
-        if(right_im_h > 0)
-        {
-            for(int i = 0; i < right_im_w; i += step) colorCountMap[right_img.pixel(i, 0)]++;
-        }
-
-        // Right image - bottom
-        if(right_im_h > 0)
-        {
-            for(int i = 0; i < right_im_w; i += step) colorCountMap[right_img.pixel(i, right_im_h - 1)]++;
-        }
-
-        // Right image - right side
-        if(right_im_w > 0 && right_img.isNull())
-        {
-            for(int i = 0; i < right_im_h; i += step) colorCountMap[right_img.pixel(right_im_w - 1, i)]++;
-        }
-    }
-
-    int maxcnt = 0;
-    QRgb maxval = 0;
-    bool ok = false;
-    for(const auto& k: colorCountMap.keys())
-    {
-        if(colorCountMap[k] > maxcnt)
-        {
-            maxcnt = colorCountMap[k];
-            maxval = k;
-            ok = true;
-        }
-    }
+    const int step = getEdgeColorStep();
+    return EdgeColorHistogram::mostCommonColor(EdgeColorHistogram::fromImage(left_img, step), EdgeColorHistogram::fromImage(right_img, step));
+}
 
-    if(!ok) return Qt::transparent;
-    return QColor::fromRgba(maxval);
+int MainWindow::getEdgeColorStep()
+{
+    static const int step = MainWindow::getOption("fasterDynamicBackgroundDetection").toBool() ? 4 : 1;
+    return step;
 }
 
 MainWindow::~MainWindow()
@@ -758,6 +735,80 @@ void MainWindow::on_actionMinimize_triggered()
     this->showMinimized();
 }
 
+void MainWindow::changeEvent(QEvent* event)
+{
+    QMainWindow::changeEvent(event);
+    if(event->type() == QEvent::WindowStateChange)
+        updateBackgroundState(!this->isVisible());
+}
+
+void MainWindow::hideEvent(QHideEvent* event)
+{
+    QMainWindow::hideEvent(event);
+    // also sent when the window system unmaps the window, e.g. on minimizing or switching desktops
+    updateBackgroundState(true);
+}
+
+void MainWindow::showEvent(QShowEvent* event)
+{
+    QMainWindow::showEvent(event);
+    updateBackgroundState(false);
+}
+
+void MainWindow::updateBackgroundState(bool hidden)
+{
+    if(!releaseMemoryInBackground) return;
+
+    const bool background = hidden || this->isMinimized();
+    if(background && !releasedForBackground)
+        releaseMemoryForBackground();
+    else if(!background && releasedForBackground)
+        rewarmFromBackground();
+}
+
+void MainWindow::releaseMemoryForBackground()
+{
+    releasedForBackground = true;
+    MemoryGovernor::governor().setBackground(true);
+    imagePreloader->stopCurrentWork();
+    for(auto t: std::as_const(thumbnailerThreads))
+    {
+        t->stopCurrentWork();
+    }
+
+    // only the pages on screen are kept, so the window can be painted at once when it comes back
+    QList<QPair<QString, int>> visiblePages;
+    if(auto comic = this->ui->view->comicSource())
+    {
+        visiblePages.append({comic->getID(), this->ui->view->currentPage() - 1});
+        visiblePages.append({comic->getID(), this->ui->view->currentPage()});
+    }
+    ImageCache::cache().retain(visiblePages);
+    this->ui->view->releaseFittedPages();
+    EncodedCache::cache().shrinkTo(0);
+    ImageBufferPool::pool().trim();
+    MemoryGovernor::returnFreedMemory();
+}
+
+void MainWindow::rewarmFromBackground()
+{
+    releasedForBackground = false;
+    MemoryGovernor::governor().setBackground(false);
+    auto comic = this->ui->view->comicSource();
+    if(!comic) return;
+
+    // the neighborhood of the current page comes first, thumbnails follow once it had a head start
+    imagePreloader->preloadPages(comic, this->ui->view->currentPage());
+    QTimer::singleShot(1000, this, [this, comic]() {
+        if(releasedForBackground || this->ui->view->comicSource() != comic) return;
+        for(auto t: std::as_const(thumbnailerThreads))
+        {
+            t->startWorking(comic);
+            t->refocus(this->ui->view->currentPage());
+        }
+    });
+}
+
 void MainWindow::on_actionFullscreen_toggled(bool on)
 {
     if(on)
@@ -917,6 +968,7 @@ void MainWindow::loadComic(ComicSource* comic)
     }
 
     delete oldComic;
+    watchComicDirectory(comic);
 
     if(comic)
     {
@@ -933,6 +985,57 @@ void MainWindow::loadComic(ComicSource* comic)
     this->ui->view->setFocus(Qt::OtherFocusReason);
 }
 
+void MainWindow::watchComicDirectory(ComicSource* comic)
+{
+    comicDirectoryRefreshTimer.stop();
+    if(!comicDirectoryWatcher.directories().isEmpty())
+        comicDirectoryWatcher.removePaths(comicDirectoryWatcher.directories());
+    if(dynamic_cast<DirectoryComicSource*>(comic) && getOption("watchOpenedDirectory").toBool())
+        comicDirectoryWatcher.addPath(comic->getPath());
+}
+
+void MainWindow::refreshComicDirectory()
+{
+    auto comic = dynamic_cast<DirectoryComicSource*>(this->ui->view->comicSource());
+    if(!comic) return;
+    if(comicDirectoryScan.isRunning())
+    {
+        // files kept coming while the last listing was taken
+        comicDirectoryRefreshTimer.start();
+        return;
+    }
+
+    // if the folder has to be opened again, the new source starts at the file of the current page
+    const QString currentFile = comic->getPageFilePath(this->ui->view->currentPage() - 1);
+    const QString path = QFileInfo::exists(currentFile) ? currentFile : comic->getPath();
+    comicDirectoryScanID = comic->getID();
+    comicDirectoryScan.setFuture(QtConcurrent::run([path]() {
+        return new DirectoryComicSource(path);
+    }));
+}
+
+void MainWindow::onComicDirectoryScanned()
+{
+    std::unique_ptr<DirectoryComicSource> refreshed(comicDirectoryScan.result());
+    auto comic = dynamic_cast<DirectoryComicSource*>(this->ui->view->comicSource());
+    if(!comic || comic->getID() != comicDirectoryScanID || refreshed->getPageCount() == 0) return;
+
+    // pages added after the last one or removed from the end leave the others where they are
+    const int pageCount = comic->getPageCount();
+    if(comic->update(*refreshed))
+    {
+        if(comic->getPageCount() != pageCount) this->ui->view->pageCountChanged();
+        return;
+    }
+
+    const int currentPage = this->ui->view->currentPage();
+    // the new source starts at the file of the current page, or at the first page if that file is gone
+    const bool currentFileKept = refreshed->getPageFilePath(refreshed->startAtPage() - 1) == comic->getPageFilePath(currentPage - 1);
+    const int refreshedCount = refreshed->getPageCount();
+    this->loadComic(refreshed.release());
+    if(!currentFileKept) this->ui->view->goToPage(std::min(currentPage, refreshedCount));
+}
+
 void MainWindow::stopThreads()
 {
     imagePreloader->exit();
@@ -1587,6 +1690,23 @@ bool FileSystemFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelInd
     return false;
 }
 
+bool FileSystemFilterProxyModel::lessThan(const QModelIndex& left, const QModelIndex& right) const
+{
+    if(left.column() != 0) return QSortFilterProxyModel::lessThan(left, right);
+    auto model = static_cast<QFileSystemModel*>(this->sourceModel());
+    const bool leftIsDir = model->isDir(left);
+    if(leftIsDir != model->isDir(right)) return leftIsDir;
+    return sortKey(model->fileName(left)).compare(sortKey(model->fileName(right))) < 0;
+}
+
+QCollatorSortKey FileSystemFilterProxyModel::sortKey(const QString& name) const
+{
+    // the view sorts a folder again whenever it changes, the names mostly stay the same
+    if(auto it = sortKeys.constFind(name); it != sortKeys.cend()) return *it;
+    if(sortKeys.size() > 50000) sortKeys.clear();
+    return *sortKeys.insert(name, NaturalSort::key(name));
+}
+
 void MainWindow::on_actionFirst_page_triggered()
 {
     this->ui->view->firstPage();
@@ -1703,6 +1823,12 @@ void MainWindow::on_actionDouble_page_mode_triggered(bool checked)
     setOption("doublePageMode", checked);
 }
 
+void MainWindow::on_actionContinuous_scroll_mode_triggered(bool checked)
+{
+    this->ui->view->setContinuousMode(checked);
+    setOption("continuousScrollMode", checked);
+}
+
 void MainWindow::on_actionZoom_in_triggered()
 {
     this->ui->view->zoomIn();
@@ -1752,16 +1878,19 @@ void MainWindow::updateUIState()
 {
     bool autoOpenNextComic = MainWindow::getOption("autoOpenNextComic").toBool();
     auto src = this->ui->view->comicSource();
-    this->ui->actionNext_comic->setEnabled(src && src->hasNextComic());
-    this->ui->actionPrevious_comic->setEnabled(src && src->hasPreviousComic());
+    // never waits for the folder to be listed, the actions are updated again once it is
+    const bool neighborsKnown = src && src->neighborsKnown();
+    this->ui->actionNext_comic->setEnabled(neighborsKnown && src->hasNextComic());
+    this->ui->actionPrevious_comic->setEnabled(neighborsKnown && src->hasPreviousComic());
     this->ui->actionFirst_page->setEnabled(src && !this->ui->view->onFirstPage());
     this->ui->actionLast_page->setEnabled(src && !this->ui->view->onLastPage());
-    this->ui->actionPrevious_page->setEnabled(src && (!this->ui->view->onFirstPage() || (autoOpenNextComic && src->hasPreviousComic())));
-    this->ui->actionNext_page->setEnabled(src && (!this->ui->view->onLastPage() || (autoOpenNextComic && src->hasNextComic())));
+    this->ui->actionPrevious_page->setEnabled(src && (!this->ui->view->onFirstPage() || (autoOpenNextComic && neighborsKnown && src->hasPreviousComic())));
+    this->ui->actionNext_page->setEnabled(src && (!this->ui->view->onLastPage() || (autoOpenNextComic && neighborsKnown && src->hasNextComic())));
     this->ui->actionGo_to_page->setEnabled(src && src->getPageCount() > 0);
     this->ui->actionOpen_image_with->setEnabled(src && this->ui->view->currentPage() > 0);
     this->ui->actionDouble_page_mode->setChecked(this->ui->view->isDoublePageMode());
     this->ui->actionManga_mode->setChecked(this->ui->view->isMangaMode());
+    this->ui->actionContinuous_scroll_mode->setChecked(this->ui->view->isContinuousMode());
     this->ui->actionStretch_small_images->setChecked(this->ui->view->stretchesSmallImages());
     this->ui->actionSmart_scroll_vertical_first->setChecked(this->ui->view->smartScrollVerticalFirst());
     this->ui->actionKeep_transformation->setChecked(this->ui->view->transformationKept());
@@ -21,13 +21,18 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "metadata.h"
 #include "3rdparty/ksqueezedtextlabel.h"
+#include <QCollatorSortKey>
 #include <QFileSystemModel>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QKeyEvent>
 #include <QMainWindow>
 #include <QScrollBar>
 #include <QSortFilterProxyModel>
+#include <QTimer>
 #include <QTreeWidget>
 #include <QVariant>
 
@@ -39,6 +44,7 @@ namespace Ui
 class Thumbnailer;
 class ImagePreloader;
 class ComicSource;
+class DirectoryComicSource;
 class QSettings;
 
 class FileSystemFilterProxyModel : public QSortFilterProxyModel
@@ -51,6 +57,12 @@ public:
 
 protected:
     bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
+    // folders first, then natural order of the names
+    bool lessThan(const QModelIndex& left, const QModelIndex& right) const override;
+
+private:
+    QCollatorSortKey sortKey(const QString& name) const;
+    mutable QHash<QString, QCollatorSortKey> sortKeys;
 };
 
 class MainWindow : public QMainWindow
@@ -65,6 +77,7 @@ public:
     static bool setOption(const QString& key, const QVariant& val);
     static bool hasOption(const QString& key);
     static QColor getMostCommonEdgeColor(const QImage& left_img, const QImage& right_img);
+    static int getEdgeColorStep();
 
     explicit MainWindow(QWidget* parent = nullptr);
     void initSettings(const QString &profile = "default");
@@ -115,6 +128,7 @@ private slots:
     void on_actionSmart_scroll_vertical_first_triggered(bool checked);
     void on_actionManga_mode_triggered(bool checked);
     void on_actionDouble_page_mode_triggered(bool checked);
+    void on_actionContinuous_scroll_mode_triggered(bool checked);
     void on_actionZoom_in_triggered();
     void on_actionZoom_out_triggered();
     void on_actionReset_zoom_triggered();
@@ -135,8 +149,19 @@ private slots:
 
 protected:
     void closeEvent(QCloseEvent* event) override;
+    void changeEvent(QEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+    void showEvent(QShowEvent* event) override;
 
 private:
+    // the window is in the background while it is minimized or hidden
+    void updateBackgroundState(bool hidden);
+    void releaseMemoryForBackground();
+    void rewarmFromBackground();
+    // a folder opened as a comic follows files being added to or removed from it
+    void watchComicDirectory(ComicSource* comic);
+    void refreshComicDirectory();
+    void onComicDirectoryScanned();
     void loadComic(ComicSource* src);
     void loadComic(const QStringList& path, bool onStartup = false);
     void nextPage();
@@ -177,6 +202,13 @@ private:
     QStringList recentFiles;
     QList<Thumbnailer*> thumbnailerThreads;
     ImagePreloader* imagePreloader = nullptr;
+    bool releaseMemoryInBackground = false;
+    bool releasedForBackground = false;
+    QFileSystemWatcher comicDirectoryWatcher;
+    QTimer comicDirectoryRefreshTimer;
+    // the folder is listed on a worker thread, the result is only used if the same source is still open
+    QFutureWatcher<DirectoryComicSource*> comicDirectoryScan;
+    QString comicDirectoryScanID;
     static QSettings* userProfile;
     static QSettings* defaultSettings;
     int statusbarCurrPage = 0;
@@ -0,0 +1,172 @@
+#include "memorygovernor.h"
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+#include <QTimer>
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace
+{
+    // share of time (in percent over the last 10 seconds) some task stalled on memory
+    constexpr double pressureHigh = 10.0;
+    constexpr double pressureLow = 2.0;
+    constexpr int pressurePollMs = 2000;
+    // under pressure the caches are brought down to this fraction of the budget
+    constexpr double pressureBudgetFactor = 0.5;
+
+    qint64 readLimitFile(const QString& path)
+    {
+        QFile file(path);
+        if(!file.open(QIODevice::ReadOnly)) return 0;
+        bool ok = false;
+        // "max" (cgroup v2) and the huge v1 default both mean no limit
+        const qint64 limit = file.readAll().trimmed().toLongLong(&ok);
+        return ok && limit > 0 && limit < (qint64(1) << 50) ? limit : 0;
+    }
+}
+
+MemoryGovernor& MemoryGovernor::governor()
+{
+    static MemoryGovernor governor;
+    return governor;
+}
+
+void MemoryGovernor::registerCache(const QString& name, Tier tier, std::function<qint64()> usage, std::function<void(qint64)> shrinkTo)
+{
+    QMutexLocker lock(&mut);
+    clients.append({name, tier, std::move(usage), std::move(shrinkTo)});
+    std::stable_sort(clients.begin(), clients.end(), [](const Client& a, const Client& b) { return a.tier < b.tier; });
+}
+
+void MemoryGovernor::initialize(const QString& budget, bool followPressure)
+{
+    const QString str = budget.trimmed();
+    if(str.endsWith('%'))
+        budgetBytes = qint64(availableMemory() * str.chopped(1).toDouble() / 100.0);
+    else
+        budgetBytes = str.toLongLong() * 1024 * 1024;
+
+#ifdef Q_OS_LINUX
+    if(followPressure && QFile::exists("/proc/pressure/memory") && !pressureTimer)
+    {
+        pressureTimer = new QTimer;
+        QObject::connect(pressureTimer, &QTimer::timeout, [this]() { checkPressure(); });
+        pressureTimer->start(pressurePollMs);
+    }
+#else
+    Q_UNUSED(followPressure)
+#endif
+    rebalance();
+}
+
+qint64 MemoryGovernor::budget() const
+{
+    return budgetBytes;
+}
+
+bool MemoryGovernor::allowPrefetch() const
+{
+    return !underPressure && !overBudget && !background;
+}
+
+void MemoryGovernor::setBackground(bool background)
+{
+    this->background = background;
+}
+
+void MemoryGovernor::rebalance()
+{
+    if(budgetBytes <= 0) return;
+    // a rebalance running on another thread (or further up this one) sees the flag and runs again
+    // before it lets go of the lock, so no growth goes unaccounted
+    rebalanceRequested = true;
+    while(rebalanceRequested && mut.tryLock())
+    {
+        while(rebalanceRequested.exchange(false))
+            shed();
+        mut.unlock();
+    }
+}
+
+void MemoryGovernor::shed()
+{
+    const qint64 target = underPressure ? qint64(budgetBytes * pressureBudgetFactor) : budgetBytes;
+    QVector<qint64> usages;
+    qint64 total = 0;
+    for(const auto& c: std::as_const(clients))
+    {
+        usages.append(c.usage());
+        total += usages.back();
+    }
+    const bool wasOverBudget = overBudget;
+    // some headroom before prefetching resumes, so it doesn't refill what was just shed
+    overBudget = total > (overBudget ? target * 9 / 10 : target);
+
+    // shed whole tiers in order until the total fits, shrinking the last one only as far as needed
+    for(int i = 0; i < clients.size() && total > target; i++)
+    {
+        const qint64 keep = std::max<qint64>(0, usages[i] - (total - target));
+        clients[i].shrinkTo(keep);
+        const qint64 now = clients[i].usage();
+        total -= usages[i] - now;
+    }
+    if(overBudget)
+    {
+        // buffers of the pages dropped above went back to the idle pool
+        for(const auto& c: std::as_const(clients))
+            if(c.tier == Tier::Prefetch) c.shrinkTo(0);
+    }
+    if(overBudget != wasOverBudget)
+        qDebug() << (overBudget ? "memory governor over budget, caches shed to" : "memory governor back within budget at") << total / (1024 * 1024) << "MB";
+}
+
+qint64 MemoryGovernor::availableMemory()
+{
+    qint64 memory = 0;
+#ifdef Q_OS_UNIX
+    memory = qint64(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+#endif
+    if(memory <= 0) memory = qint64(4) * 1024 * 1024 * 1024;
+#ifdef Q_OS_LINUX
+    for(const auto& path: {"/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes"})
+    {
+        if(const qint64 limit = readLimitFile(path); limit > 0) memory = std::min(memory, limit);
+    }
+#endif
+    return memory;
+}
+
+void MemoryGovernor::returnFreedMemory()
+{
+#ifdef __GLIBC__
+    // large pages go back through munmap anyway, this also releases the fragmented heap
+    malloc_trim(0);
+#endif
+}
+
+void MemoryGovernor::checkPressure()
+{
+    // some avg10=1.23 avg60=0.50 avg300=0.10 total=123456
+    QFile file("/proc/pressure/memory");
+    if(!file.open(QIODevice::ReadOnly)) return;
+    const QByteArray line = file.readLine();
+    const int start = line.indexOf("avg10=");
+    if(!line.startsWith("some") || start < 0) return;
+    const double avg10 = line.mid(start + 6, line.indexOf(' ', start) - start - 6).toDouble();
+
+    const bool wasUnderPressure = underPressure;
+    if(!wasUnderPressure && avg10 >= pressureHigh) underPressure = true;
+    else if(wasUnderPressure && avg10 <= pressureLow) underPressure = false;
+    if(underPressure != wasUnderPressure)
+    {
+        qDebug() << "memory pressure" << (underPressure ? "high" : "gone") << "avg10:" << avg10;
+        rebalance();
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+class QTimer;
+
+/**
+ * One memory budget shared by all in-memory caches. Every cache registers how to report its size
+ * and how to shrink to a target, together with a tier. When the caches together exceed the budget
+ * the governor sheds them tier by tier: prefetching and idle buffers first, thumbnails second,
+ * compressed pages third and decoded pages last.
+ * On Linux it also follows /proc/pressure/memory, under system memory pressure prefetching is
+ * paused and the caches are shrunk below the budget until the pressure goes away.
+ */
+class MemoryGovernor
+{
+public:
+    // in shedding order
+    enum class Tier
+    {
+        Prefetch,
+        Thumbnails,
+        Encoded,
+        Decoded
+    };
+
+    static MemoryGovernor& governor();
+    // usage reports the bytes a cache holds, shrinkTo releases entries until it holds at most the given bytes
+    void registerCache(const QString& name, Tier tier, std::function<qint64()> usage, std::function<void(qint64)> shrinkTo);
+    // budget is either a size in megabytes or a percentage of the available memory (e.g. "25%"),
+    // which is the smaller of the physical memory and the cgroup limit
+    void initialize(const QString& budget, bool followPressure);
+    qint64 budget() const;
+    // false while the caches are over budget, the system is under memory pressure or the window is minimized
+    bool allowPrefetch() const;
+    void setBackground(bool background);
+    // called by caches after they grew, shrinks others if the budget is exceeded
+    void rebalance();
+
+    static qint64 availableMemory();
+    // hands memory freed by the caches back to the system instead of keeping it in the allocator
+    static void returnFreedMemory();
+
+private:
+    struct Client
+    {
+        QString name;
+        Tier tier;
+        std::function<qint64()> usage;
+        std::function<void(qint64)> shrinkTo;
+    };
+    void checkPressure();
+    // one pass over the caches, called with mut held
+    void shed();
+    qint64 budgetBytes = 0;
+    std::atomic_bool underPressure = false;
+    std::atomic_bool overBudget = false;
+    std::atomic_bool background = false;
+    std::atomic_bool rebalanceRequested = false;
+    QVector<Client> clients;
+    QMutex mut;
+    QTimer* pressureTimer = nullptr;
+};
@@ -1,68 +1,163 @@
 #include "mobicomicsource.h"
 #include "imagecache.h"
+#include "grayscale.h"
+#include "imagebufferpool.h"
 
-//TODO
+#include <QBuffer>
 #include <QCryptographicHash>
-#include <QMimeDatabase>
-#include <QDir>
-#include <QTemporaryFile>
-#include <QCollator>
+#include <QImageReader>
+#include <QTextCodec>
+#include <QtEndian>
 #include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Palm database header, followed by one 8 byte entry per record
+    constexpr int pdbHeaderSize = 78;
+    constexpr int pdbTypeOffset = 60;
+    constexpr int pdbRecordCountOffset = 76;
+    // offsets into record 0: the PalmDOC header, then the MOBI header
+    constexpr int encryptionOffset = 12;
+    constexpr int mobiHeaderOffset = 16;
+    constexpr int textEncodingOffset = 28;
+    constexpr int fullNameOffset = 84;
+    constexpr int firstImageIndexOffset = 108;
+    constexpr int exthFlagsOffset = 128;
+    // EXTH record types
+    constexpr quint32 exthAuthor = 100;
+    constexpr quint32 exthUpdatedTitle = 503;
+
+    quint32 readBE32(const uchar* p)
+    {
+        return qFromBigEndian<quint32>(p);
+    }
+
+    quint16 readBE16(const uchar* p)
+    {
+        return qFromBigEndian<quint16>(p);
+    }
+
+    // the records of a comic are images interleaved with fonts, indices and other resources.
+    // Returns the file name suffix of the image format, empty for other records.
+    QString imageSuffix(const uchar* p, qint64 size)
+    {
+        if(size >= 3 && p[0] == 0xFF && p[1] == 0xD8 && p[2] == 0xFF) return "jpg";
+        if(size >= 8 && std::memcmp(p, "\x89PNG\r\n\x1a\n", 8) == 0) return "png";
+        if(size >= 6 && (std::memcmp(p, "GIF87a", 6) == 0 || std::memcmp(p, "GIF89a", 6) == 0)) return "gif";
+        // "BM" alone is too likely at the start of other data, the stored file size has to fit too
+        if(size >= 26 && p[0] == 'B' && p[1] == 'M')
+        {
+            const quint32 bmpSize = qFromLittleEndian<quint32>(p + 2);
+            if(bmpSize >= 26 && bmpSize <= size) return "bmp";
+        }
+        return {};
+    }
+}
 
-/**
- * @TODO
- * libmobi filetype matches Qt mimetype: filter more image types.
- */
 MobiComicSource::MobiComicSource(const QString& path)
     :FileComicSource(path)
 {
     signatureMimeStr = "application/x-mobipocket-ebook";
-    this->meta.f = nullptr;
-    this->meta.mobi = nullptr;
-    this->meta.rawml = nullptr;
     this->meta.path = QFileInfo(path).absoluteFilePath();
 
-    this->meta.mobi = mobi_init();
-    this->meta.f = fopen(path.toStdString().data(), "rb");
-    assert(this->meta.f != nullptr);
-    auto ret1 = mobi_load_file(this->meta.mobi, this->meta.f);
-
-    this->meta.title = mobi_meta_get_title(this->meta.mobi);
-    this->meta.author = mobi_meta_get_author(this->meta.mobi);
-
-    this->meta.rawml = mobi_init_rawml(this->meta.mobi);
-    auto ret2 = mobi_parse_rawml(this->meta.rawml, this->meta.mobi);
-    if(this->meta.rawml != nullptr) {
-        MOBIPart *curr = this->meta.rawml->resources;
-        size_t imagePN{1};
-        size_t anyPN{1};
-        while(curr != nullptr){
-            auto file_meta = mobi_get_filemeta_by_type(curr->type);
-            //qDebug()<<QString("page of %1 is %2").arg(anyPN++).arg(type2str(curr->type));
-            switch(curr->type){
-                case T_JPG:
-                case T_PNG:
-                case T_BMP:
-                case T_GIF:
-                    this->fileList.push_back({
-                            QString("page %1").arg(imagePN++),
-                            curr->data,
-                            curr->size
-                            });
-                    break;
-                default:
-                    break;
-            }
-            curr = curr->next;
+    file.setFileName(path);
+    if(file.open(QIODevice::ReadOnly))
+    {
+        // the mapping stays for the lifetime of the source, the kernel only reads the records that are accessed
+        this->data = file.map(0, file.size());
+        this->dataSize = this->data ? file.size() : 0;
+    }
+    this->meta.valid = indexRecords();
+    if(!this->meta.valid)
+        qDebug() << "not a readable MOBI file:" << path;
+
+    this->id = QString::fromUtf8(QCryptographicHash::hash((path + +"!/\\++&" + QString::number(this->pages.size())).toUtf8(), QCryptographicHash::Md5).toHex());
+}
+
+bool MobiComicSource::indexRecords()
+{
+    if(!this->data || this->dataSize < pdbHeaderSize) return false;
+    if(std::memcmp(this->data + pdbTypeOffset, "BOOKMOBI", 8) != 0) return false;
+
+    const int recordCount = readBE16(this->data + pdbRecordCountOffset);
+    if(recordCount == 0 || pdbHeaderSize + 8 * qint64(recordCount) > this->dataSize) return false;
+    QVector<qint64> offsets(recordCount + 1);
+    for(int i = 0; i < recordCount; i++)
+        offsets[i] = readBE32(this->data + pdbHeaderSize + 8 * i);
+    offsets[recordCount] = this->dataSize;
+    for(int i = 0; i < recordCount; i++)
+        if(offsets[i] > offsets[i + 1]) return false;
+
+    const uchar* record0 = this->data + offsets[0];
+    const qint64 record0Size = offsets[1] - offsets[0];
+    if(record0Size < firstImageIndexOffset + 4 || std::memcmp(record0 + mobiHeaderOffset, "MOBI", 4) != 0) return false;
+    if(readBE16(record0 + encryptionOffset) != 0)
+    {
+        qDebug() << "encrypted MOBI files are not supported";
+        return false;
+    }
+
+    const bool utf8 = readBE32(record0 + textEncodingOffset) == 65001;
+    QTextCodec* cp1252 = QTextCodec::codecForName("Windows-1252");
+    auto decodeText = [&](const uchar* p, qint64 size) {
+        const auto bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(p), int(size));
+        if(utf8) return QString::fromUtf8(bytes);
+        return cp1252 ? cp1252->toUnicode(bytes) : QString::fromLatin1(bytes);
+    };
+
+    const quint32 nameOffset = readBE32(record0 + fullNameOffset);
+    const quint32 nameLength = readBE32(record0 + fullNameOffset + 4);
+    if(qint64(nameOffset) + nameLength <= record0Size)
+        this->meta.title = decodeText(record0 + nameOffset, nameLength);
+
+    const quint32 mobiHeaderLength = readBE32(record0 + mobiHeaderOffset + 4);
+    const qint64 exthOffset = mobiHeaderOffset + qint64(mobiHeaderLength);
+    if(record0Size >= exthFlagsOffset + 4 && (readBE32(record0 + exthFlagsOffset) & 0x40)
+       && exthOffset + 12 <= record0Size && std::memcmp(record0 + exthOffset, "EXTH", 4) == 0)
+    {
+        const quint32 exthCount = readBE32(record0 + exthOffset + 8);
+        qint64 pos = exthOffset + 12;
+        for(quint32 i = 0; i < exthCount && pos + 8 <= record0Size; i++)
+        {
+            const quint32 type = readBE32(record0 + pos);
+            const quint32 length = readBE32(record0 + pos + 4);
+            if(length < 8 || pos + length > record0Size) break;
+            if(type == exthAuthor)
+                this->meta.author = decodeText(record0 + pos + 8, length - 8);
+            else if(type == exthUpdatedTitle)
+                this->meta.title = decodeText(record0 + pos + 8, length - 8);
+            pos += length;
         }
     }
 
-    this->id = QString::fromUtf8(QCryptographicHash::hash((path + +"!/\\++&" + QString::number(this->fileList.count())).toUtf8(), QCryptographicHash::Md5).toHex());
+    const quint32 firstImage = readBE32(record0 + firstImageIndexOffset);
+    if(firstImage == 0xFFFFFFFF) return true;
+    int imagePN = 1;
+    for(int i = int(std::min<quint32>(firstImage, quint32(recordCount))); i < recordCount; i++)
+    {
+        const uchar* record = this->data + offsets[i];
+        const qint64 size = offsets[i + 1] - offsets[i];
+        // the text of the KF8 part of a joint file follows the boundary, the end of file marker closes the resources
+        if(size == 8 && std::memcmp(record, "BOUNDARY", 8) == 0) break;
+        if(size == 4 && std::memcmp(record, "\xE9\x8E\x0D\x0A", 4) == 0) break;
+        const QString suffix = imageSuffix(record, size);
+        if(suffix.isEmpty()) continue;
+        this->pages.append(QString("page %1.%2").arg(imagePN++).arg(suffix), size, offsets[i]);
+    }
+    return true;
+}
+
+QByteArray MobiComicSource::pageData(int pageNum) const
+{
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(this->data + this->pages.dataOffset(pageNum)),
+                                   int(this->pages.fileSize(pageNum)));
 }
 
 int MobiComicSource::getPageCount() const
 {
-    return this->fileList.length();
+    return this->pages.size();
 }
 
 QPixmap MobiComicSource::getPagePixmap(int pageNum)
@@ -71,16 +166,26 @@ QPixmap MobiComicSource::getPagePixmap(int pageNum)
     if(auto img = ImageCache::cache().getImage(cacheKey); !img.isNull())
         return img;
 
-    QPixmap img;
-    img.loadFromData(fileList[pageNum].data, fileList[pageNum].size);
+    auto img = Grayscale::toPixmap(ImageBufferPool::pool().decode(pageData(pageNum)));
     ImageCache::cache().addImage(cacheKey, img);
     return img;
 }
 
-QString MobiComicSource::getPageFilePath(int pageNum)
+QSize MobiComicSource::getPageSize(int pageNum)
+{
+    if(auto size = ComicSource::getPageSize(pageNum); size.isValid()) return size;
+    if(auto size = this->pages.imageSize(pageNum); size.isValid()) return size;
+
+    // only the image header is read
+    auto bytes = pageData(pageNum);
+    QBuffer buffer(&bytes);
+    const QSize size = QImageReader(&buffer).size();
+    if(size.isValid()) this->pages.setImageSize(pageNum, size);
+    return size;
+}
+
+QString MobiComicSource::getPageFilePath(int)
 {
-    QTemporaryFile tmp;
-    tmp.setAutoRemove(false);
     return "why";
 }
 
@@ -95,33 +200,19 @@ ComicMetadata MobiComicSource::getComicMetadata() const
     ComicMetadata meta;
     meta.title = this->meta.title;
     meta.fileName = this->meta.path;
-    meta.valid = (this->meta.f != nullptr)? true:false;
+    meta.valid = this->meta.valid;
     return meta;
 }
 PageMetadata MobiComicSource::getPageMetadata(int pageNum)
 {
-    QMimeDatabase mdb;
-    PageMetadata res;
-    auto px = getPagePixmap(pageNum);
-    res.width = px.width();
-    res.height = px.height();
-    res.fileName = this->fileList[pageNum].name;
-    res.fileSize = this->fileList[pageNum].size;
-    res.fileType = mdb.mimeTypeForFile(this->fileList[pageNum].name + ".jpg").name();
-    res.valid = true;
-    return res;
+    if(!this->pages.imageSize(pageNum).isValid())
+        this->pages.setImageSize(pageNum, getPageSize(pageNum));
+    return this->pages.metadata(pageNum);
 }
 
 MobiComicSource::~MobiComicSource()
 {
-    if(this->meta.rawml){
-        mobi_free_rawml(this->meta.rawml);
-    }
-    if(this->meta.mobi){
-        mobi_free(this->meta.mobi);
-    }
-    if(this->meta.f){
-        fclose(this->meta.f);
+    if(this->data){
+        file.unmap(const_cast<uchar*>(this->data));
     }
 }
-
@@ -1,7 +1,13 @@
 #pragma once
 
 #include "comicsource.h"
+#include <QFile>
 
+/**
+ * Reads the image records of MOBI/AZW books straight from the Palm database.
+ * Opening only walks the record table and the header of record 0,
+ * the file is mapped and an image record is only touched when its page is decoded.
+ */
 class MobiComicSource final : public FileComicSource
 {
 public:
@@ -13,6 +19,7 @@ public:
     virtual PageMetadata getPageMetadata(int pageNum) override;
     virtual QPixmap getPagePixmap(int pageNum) override;
     virtual QString getPageFilePath(int pageNum) override;
+    virtual QSize getPageSize(int pageNum) override;
     virtual ~MobiComicSource();
 
 private:
@@ -20,14 +27,15 @@ private:
         QString title;
         QString author;
         QString path;
-        FILE *f;
-        MOBIData *mobi;
-        MOBIRawml *rawml;
+        bool valid = false;
     } meta;
-    struct pagefile {
-        QString name;
-        const unsigned char * data;
-        size_t size;
-    };
-    QList<pagefile> fileList;
+    // reads record 0 and the record table, fills meta and pages
+    bool indexRecords();
+    // the image record of a page, valid as long as the file stays mapped
+    QByteArray pageData(int pageNum) const;
+    QFile file;
+    const uchar* data = nullptr;
+    qint64 dataSize = 0;
+    // the data offset of a page is the position of its record in the file
+    PageTable pages;
 };
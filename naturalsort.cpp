@@ -0,0 +1,49 @@
+#include "naturalsort.h"
+#include <QCollator>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+    // QCollator is only reentrant, each thread gets its own
+    const QCollator& collator()
+    {
+        static thread_local QCollator collator = [] {
+            QCollator res;
+            res.setNumericMode(true);
+            return res;
+        }();
+        return collator;
+    }
+}
+
+QVector<int> NaturalSort::order(int count, const std::function<QString(int)>& nameOf)
+{
+    std::vector<QCollatorSortKey> keys;
+    keys.reserve(count);
+    for(int i = 0; i < count; i++)
+        keys.push_back(collator().sortKey(nameOf(i)));
+
+    QVector<int> res(count);
+    std::iota(res.begin(), res.end(), 0);
+    std::stable_sort(res.begin(), res.end(), [&keys](int a, int b) {
+        return keys[a].compare(keys[b]) < 0;
+    });
+    return res;
+}
+
+void NaturalSort::sort(QFileInfoList& files)
+{
+    const auto sorted = order(files.size(), [&files](int i) { return files[i].fileName(); });
+    QFileInfoList res;
+    res.reserve(files.size());
+    for(int i: sorted)
+        res.append(files[i]);
+    files = res;
+}
+
+QCollatorSortKey NaturalSort::key(const QString& name)
+{
+    return collator().sortKey(name);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QCollatorSortKey>
+#include <QFileInfoList>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+/**
+ * Natural order for file names: numbers compare by value, text by the collation of the locale.
+ * Collating is the expensive part, so every name is turned into a sort key once
+ * and the sort only compares keys, instead of collating both names on each of the n log n comparisons.
+ */
+class NaturalSort
+{
+public:
+    // the indices 0..count-1 ordered by nameOf
+    static QVector<int> order(int count, const std::function<QString(int)>& nameOf);
+    // sorts by file name
+    static void sort(QFileInfoList& files);
+    // for models that compare one pair at a time, callers should keep the keys of the names they see
+    static QCollatorSortKey key(const QString& name);
+};
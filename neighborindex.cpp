@@ -0,0 +1,110 @@
+#include "neighborindex.h"
+#include "naturalsort.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMimeDatabase>
+#include <QMutexLocker>
+#include <QtConcurrent/QtConcurrentRun>
+
+// folders whose listings are kept, browsing through more starts over
+static constexpr int MAX_NEIGHBOR_LISTINGS = 32;
+
+NeighborIndex& NeighborIndex::index()
+{
+    // never destroyed, a listing may still be built while the process exits
+    static NeighborIndex* instance = new NeighborIndex;
+    return *instance;
+}
+
+bool NeighborIndex::prefetch(const QString& dirPath, const QString& mimeType)
+{
+    const Key key{QDir(dirPath).absolutePath(), mimeType};
+    const QDateTime modified = QFileInfo(key.first).lastModified();
+
+    QMutexLocker lock(&mutex);
+    if(auto it = listings.constFind(key); it != listings.constEnd() && (*it)->modified == modified)
+        return true;
+    if(pending.value(key).isRunning())
+        return false;
+    pending[key] = QtConcurrent::run([this, key, modified]() {
+        store(key, build(key, modified));
+        mutex.lock();
+        pending.remove(key);
+        mutex.unlock();
+        emit listingReady(key.first);
+    });
+    return false;
+}
+
+QString NeighborIndex::neighbor(const QString& filePath, const QString& mimeType, int offset)
+{
+    const QFileInfo info(filePath);
+    const auto current = listing({info.absolutePath(), mimeType});
+    const int pos = current->positions.value(info.absoluteFilePath(), -1);
+    if(pos < 0 || pos + offset < 0 || pos + offset >= current->files.size())
+        return {};
+    return current->files[pos + offset].absoluteFilePath();
+}
+
+QSharedPointer<const NeighborIndex::Listing> NeighborIndex::listing(const Key& key)
+{
+    const QDateTime modified = QFileInfo(key.first).lastModified();
+
+    QFuture<void> building;
+    {
+        QMutexLocker lock(&mutex);
+        if(auto it = listings.constFind(key); it != listings.constEnd() && (*it)->modified == modified)
+            return *it;
+        building = pending.value(key);
+    }
+
+    // a prefetch of the same folder is likely on its way, waiting for it is cheaper than listing twice
+    if(building.isRunning())
+    {
+        building.waitForFinished();
+        QMutexLocker lock(&mutex);
+        if(auto it = listings.constFind(key); it != listings.constEnd() && (*it)->modified == modified)
+            return *it;
+    }
+
+    auto res = build(key, modified);
+    store(key, res);
+    return res;
+}
+
+QSharedPointer<const NeighborIndex::Listing> NeighborIndex::build(const Key& key, const QDateTime& modified)
+{
+    auto res = QSharedPointer<Listing>::create();
+    res->modified = modified;
+
+    QMimeDatabase mimeDb;
+    QDirIterator it(key.first, QDir::Files | QDir::NoDotAndDotDot);
+    while(it.hasNext())
+    {
+        const QString filePath = it.next();
+        const QFileInfo info = it.fileInfo();
+        // the suffix decides, reading the file is only worth it when there is none
+        const auto mime = info.suffix().isEmpty()
+                              ? mimeDb.mimeTypeForFile(filePath, QMimeDatabase::MatchContent)
+                              : mimeDb.mimeTypeForFile(info.fileName(), QMimeDatabase::MatchExtension);
+        if(mime.inherits(key.second))
+            res->files.append(info);
+    }
+
+    NaturalSort::sort(res->files);
+    res->positions.reserve(res->files.size());
+    for(int i = 0; i < res->files.size(); i++)
+        res->positions.insert(res->files[i].absoluteFilePath(), i);
+    return res;
+}
+
+void NeighborIndex::store(const Key& key, const QSharedPointer<const Listing>& listing)
+{
+    QMutexLocker lock(&mutex);
+    if(!listings.contains(key) && listings.size() >= MAX_NEIGHBOR_LISTINGS)
+        listings.clear();
+    // a listing taken before another thread's newer one must not replace it
+    if(auto it = listings.constFind(key); it == listings.constEnd() || (*it)->modified <= listing->modified)
+        listings.insert(key, listing);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QDateTime>
+#include <QFileInfoList>
+#include <QFuture>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QSharedPointer>
+#include <QString>
+
+/**
+ * The comics next to an opened one, shared by all sources of the process.
+ * For every folder and comic type the matching files are listed and sorted in natural order once,
+ * the listing stays valid until the modification time of the folder changes (files added, removed or renamed).
+ * Files are classified by suffix, only the ones without a suffix are sniffed by content,
+ * so listing a folder of thousands of archives costs one directory read instead of opening every file.
+ */
+class NeighborIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    static NeighborIndex& index();
+    // true if an up to date listing exists. Otherwise the folder is listed on a worker thread,
+    // unless that is already happening, and listingReady is emitted when it is done.
+    bool prefetch(const QString& dirPath, const QString& mimeType);
+    // the file offset places after (or before, for a negative offset) filePath in its folder, empty past the ends.
+    // Waits for a listing that is being built.
+    QString neighbor(const QString& filePath, const QString& mimeType, int offset);
+
+signals:
+    void listingReady(const QString& dirPath);
+
+private:
+    NeighborIndex() = default;
+    struct Listing
+    {
+        QDateTime modified;
+        QFileInfoList files;
+        // absolute file path -> position in files
+        QHash<QString, int> positions;
+    };
+    // folder and mime type
+    using Key = QPair<QString, QString>;
+    // an up to date listing, waits for the one being built or lists the folder on the calling thread
+    QSharedPointer<const Listing> listing(const Key& key);
+    static QSharedPointer<const Listing> build(const Key& key, const QDateTime& modified);
+    void store(const Key& key, const QSharedPointer<const Listing>& listing);
+
+    QMutex mutex;
+    QHash<Key, QSharedPointer<const Listing>> listings;
+    QHash<Key, QFuture<void>> pending;
+};
@@ -0,0 +1,122 @@
+#include "pagetable.h"
+#include "naturalsort.h"
+#include <QMimeDatabase>
+
+int PageTable::append(const QString& name, qint64 fileSize, qint64 dataOffset)
+{
+    namePool.append(name);
+    nameOffsets.append(quint32(namePool.size()));
+    fileSizes.append(fileSize);
+    dataOffsets.append(dataOffset);
+    widths.append(0);
+    heights.append(0);
+    flags.append(0);
+    fileTypeIndex.append(fileTypeFor(name));
+    pageTypeIndex.append(0);
+    return fileSizes.size() - 1;
+}
+
+void PageTable::clear()
+{
+    *this = PageTable{};
+}
+
+void PageTable::reorder(const QVector<int>& order)
+{
+    PageTable res;
+    res.fileTypes = fileTypes;
+    res.fileTypeSuffixes = fileTypeSuffixes;
+    res.pageTypes = pageTypes;
+    for(int page: order)
+    {
+        res.namePool.append(namePool.constData() + nameOffsets[page], nameOffsets[page + 1] - nameOffsets[page]);
+        res.nameOffsets.append(quint32(res.namePool.size()));
+        res.fileSizes.append(fileSizes[page]);
+        res.dataOffsets.append(dataOffsets[page]);
+        res.widths.append(widths[page]);
+        res.heights.append(heights[page]);
+        res.flags.append(flags[page]);
+        res.fileTypeIndex.append(fileTypeIndex[page]);
+        res.pageTypeIndex.append(pageTypeIndex[page]);
+    }
+    res.namePool.squeeze();
+    *this = std::move(res);
+}
+
+void PageTable::sortByName()
+{
+    reorder(NaturalSort::order(size(), [this](int i) { return name(i); }));
+}
+
+QString PageTable::name(int page) const
+{
+    return namePool.mid(int(nameOffsets[page]), int(nameOffsets[page + 1] - nameOffsets[page]));
+}
+
+QSize PageTable::imageSize(int page) const
+{
+    if(widths[page] <= 0 || heights[page] <= 0) return {};
+    return {widths[page], heights[page]};
+}
+
+void PageTable::setImageSize(int page, const QSize& size)
+{
+    widths[page] = size.width();
+    heights[page] = size.height();
+}
+
+void PageTable::setBigPage(int page, bool bigPage)
+{
+    flags[page] = bigPage ? (flags[page] | BigPage) : (flags[page] & ~BigPage);
+}
+
+void PageTable::setPageType(int page, const QString& type)
+{
+    pageTypeIndex[page] = intern(pageTypes, type);
+}
+
+PageMetadata PageTable::metadata(int page) const
+{
+    PageMetadata res;
+    res.valid = true;
+    res.fileName = name(page);
+    res.fileType = fileType(page);
+    res.fileSize = int(fileSizes[page]);
+    res.width = widths[page];
+    res.height = heights[page];
+    res.isBigPage = isBigPage(page);
+    if(pageTypeIndex[page] != 0) res.tags.append(pageType(page));
+    return res;
+}
+
+qint64 PageTable::byteSize() const
+{
+    return namePool.capacity() * qint64(sizeof(QChar)) + nameOffsets.capacity() * qint64(sizeof(quint32))
+           + (fileSizes.capacity() + dataOffsets.capacity()) * qint64(sizeof(qint64))
+           + (widths.capacity() + heights.capacity()) * qint64(sizeof(qint32))
+           + flags.capacity() + fileTypeIndex.capacity() + pageTypeIndex.capacity();
+}
+
+quint8 PageTable::intern(QStringList& strings, const QString& str)
+{
+    const int index = strings.indexOf(str);
+    if(index >= 0) return quint8(index);
+    // more distinct values than fit are unlikely, they share the last slot
+    if(strings.size() > 255) return 255;
+    strings.append(str);
+    return quint8(strings.size() - 1);
+}
+
+quint8 PageTable::fileTypeFor(const QString& name)
+{
+    // the mime database is only asked once per suffix
+    const QString suffix = name.mid(name.lastIndexOf('.') + 1).toLower();
+    if(const int index = fileTypeSuffixes.indexOf(suffix); index >= 0) return quint8(index);
+    if(fileTypes.size() > 255) return 255;
+
+    QMimeDatabase mdb;
+    const auto possibleMimes = mdb.mimeTypesForFileName(name);
+    fileTypes.append(possibleMimes.empty() ? QStringLiteral("unknown") : possibleMimes[0].name());
+    fileTypeSuffixes.append(suffix);
+    return quint8(fileTypes.size() - 1);
+}
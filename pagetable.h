@@ -0,0 +1,67 @@
+#pragma once
+
+#include "metadata.h"
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * The pages of a comic as parallel arrays: one entry costs a couple dozen bytes plus its name,
+ * instead of a PageMetadata or archive file info object with its own strings per page.
+ * Names live in one UTF-16 pool, file types and page types are interned since a comic only has a few of them.
+ * Image sizes start out unknown and are filled in by the source as it learns them.
+ * Only setImageSize and setBigPage may run concurrently with readers, the arrays are never reallocated after loading.
+ */
+class PageTable
+{
+public:
+    int append(const QString& name, qint64 fileSize, qint64 dataOffset = -1);
+    int size() const { return fileSizes.size(); }
+    bool isEmpty() const { return fileSizes.isEmpty(); }
+    void clear();
+    // rearranges the pages so that page i is the former page order[i], pages not in order are dropped
+    void reorder(const QVector<int>& order);
+    // natural order of the names, see NaturalSort
+    void sortByName();
+
+    QString name(int page) const;
+    qint64 fileSize(int page) const { return fileSizes[page]; }
+    // source specific location of the page data, like the offset of a record in the file
+    qint64 dataOffset(int page) const { return dataOffsets[page]; }
+    const QString& fileType(int page) const { return fileTypes[fileTypeIndex[page]]; }
+    // invalid until known
+    QSize imageSize(int page) const;
+    void setImageSize(int page, const QSize& size);
+    bool isBigPage(int page) const { return flags[page] & BigPage; }
+    void setBigPage(int page, bool bigPage);
+    // the page type of ComicInfo.xml, like FrontCover
+    const QString& pageType(int page) const { return pageTypes[pageTypeIndex[page]]; }
+    void setPageType(int page, const QString& type);
+
+    // everything known about a page, width and height stay 0 while the size isn't known
+    PageMetadata metadata(int page) const;
+    // what the arrays and the name pool take
+    qint64 byteSize() const;
+
+private:
+    enum Flag : quint8
+    {
+        BigPage = 1
+    };
+    static quint8 intern(QStringList& strings, const QString& str);
+    quint8 fileTypeFor(const QString& name);
+
+    QString namePool;
+    QVector<quint32> nameOffsets{0}; // name i is namePool[nameOffsets[i], nameOffsets[i + 1])
+    QVector<qint64> fileSizes;
+    QVector<qint64> dataOffsets;
+    QVector<qint32> widths;
+    QVector<qint32> heights;
+    QVector<quint8> flags;
+    QVector<quint8> fileTypeIndex;
+    QVector<quint8> pageTypeIndex;
+    QStringList fileTypes;
+    QStringList fileTypeSuffixes; // the file name suffix each file type was looked up for
+    QStringList pageTypes{QString{}};
+};
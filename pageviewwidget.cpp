@@ -18,6 +18,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "pageviewwidget.h"
 #include "comicsource.h"
+#include "imagecache.h"
+#include "imagescaler.h"
+#include "imagetransform.h"
 #include "mainwindow.h"
 #include "thumbnailwidget.h"
 #include <QApplication>
@@ -29,8 +32,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <QMenu>
 
 #include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QWindow>
+#include <QtConcurrent/QtConcurrentRun>
 
 constexpr int CHECKERED_IMAGE_SIZE = 1500;
+constexpr int ZOOM_TILE_SIZE = 256;
+constexpr int MAX_ZOOM_TILES = 192;
 
 PageViewWidget::FitMode PageViewWidget::stringToFitMode(const QString& str)
 {
@@ -82,6 +91,8 @@ PageViewWidget::PageViewWidget(QWidget* parent) :
 {
     setMouseTracking(true);
     setFocusPolicy(Qt::StrongFocus);
+    // every paint covers its whole update region, this lets scroll() move pixels instead of repainting
+    setAttribute(Qt::WA_OpaquePaintEvent);
     setContextMenuPolicy(Qt::CustomContextMenu);
     connect(&this->slideShowTimer, &QTimer::timeout, [this]() {
         scrollNext(ScrollSource::SlideShowScroll);
@@ -91,6 +102,21 @@ PageViewWidget::PageViewWidget(QWidget* parent) :
             });
     connect(this, &QWidget::customContextMenuRequested,
             this, &PageViewWidget::onCustomContextMenuRequested);
+    connect(&this->pageLoadWatcher, &QFutureWatcher<void>::finished, [this]() {
+        onPageLoadFinished();
+    });
+    connect(&this->zoomTileWatcher, &QFutureWatcher<QVector<ZoomTile>>::finished, [this]() {
+        onZoomTilesRendered();
+    });
+    displaySizeTimer.setSingleShot(true);
+    displaySizeTimer.setInterval(300);
+    connect(&this->displaySizeTimer, &QTimer::timeout, [this]() {
+        onDisplaySizeSettled();
+    });
+    scrollAnimationTimer.setTimerType(Qt::PreciseTimer);
+    connect(&this->scrollAnimationTimer, &QTimer::timeout, [this]() {
+        onScrollAnimationFrame();
+    });
 }
 
 void PageViewWidget::onCustomContextMenuRequested(const QPoint& p)
@@ -151,6 +177,10 @@ void PageViewWidget::initialize(ThumbnailWidget* w)
     useAdaptiveSpaceScroll = MainWindow::getOption("useAdaptiveSpaceScroll").toBool();
     allowFreeDrag = MainWindow::getOption("allowFreeDrag").toBool();
     transparentBackgroundCheckerSize = MainWindow::getOption("checkerBoardPatternSize").toInt();
+    progressivePageLoading = MainWindow::getOption("progressivePageLoading").toBool();
+    continuousMode = MainWindow::getOption("continuousScrollMode").toBool();
+    smoothScrolling = MainWindow::getOption("smoothScrolling").toBool();
+    smoothScrollDuration = MainWindow::getOption("smoothScrollDuration").toInt();
 
     QImage tmpCheckeredBkg = QImage(QSize(CHECKERED_IMAGE_SIZE, CHECKERED_IMAGE_SIZE), QImage::Format_ARGB32);
     tmpCheckeredBkg.fill(Qt::white);
@@ -180,22 +210,25 @@ void PageViewWidget::initialize(ThumbnailWidget* w)
 void PageViewWidget::rotate(int degree)
 {
     rotationDegree += degree;
+    updtWindowIcon = true;
     emit this->pageViewConfigUINeedsToBeUpdated();
-    maintainCache(cacheKey::leftPageTransformed);
+    maintainCache(cacheKey::leftPageFitted);
 }
 
 void PageViewWidget::flipHorizontally(bool flip)
 {
     horizontalFlip = flip;
+    updtWindowIcon = true;
     emit this->pageViewConfigUINeedsToBeUpdated();
-    maintainCache(cacheKey::leftPageTransformed);
+    maintainCache(cacheKey::leftPageFitted);
 }
 
 void PageViewWidget::flipVertically(bool flip)
 {
     verticalFlip = flip;
+    updtWindowIcon = true;
     emit this->pageViewConfigUINeedsToBeUpdated();
-    maintainCache(cacheKey::leftPageTransformed);
+    maintainCache(cacheKey::leftPageFitted);
 }
 
 void PageViewWidget::zoomIn()
@@ -233,6 +266,29 @@ void PageViewWidget::resetZoom()
     emitStatusbarUpdateSignal();
 }
 
+void PageViewWidget::pageCountChanged()
+{
+    if(m_comic == nullptr)
+        return;
+
+    const int count = m_comic->getPageCount();
+    // the current page is gone, or as the last page it may get a partner in double page mode
+    if(currPage > count || (!continuousMode && isDoublePageMode() && currPage >= count - 1))
+    {
+        const int page = std::min(currPage, count);
+        currPage = 0; // goToPage ignores the current page
+        this->goToPage(page);
+    }
+    else
+    {
+        emit this->currentPageChanged(m_comic->getFilePath(), currPage, count);
+        emit this->pageViewConfigUINeedsToBeUpdated();
+    }
+    if(this->thumbsWidget)
+        this->thumbsWidget->pageCountChanged();
+    update();
+}
+
 void PageViewWidget::goToPage(int page, int doublePage)
 {
     if(m_comic == nullptr || page == currPage )
@@ -240,6 +296,15 @@ void PageViewWidget::goToPage(int page, int doublePage)
 
     if(!m_comic->isValidPage(page-1))
         return;
+    if(continuousMode)
+    {
+        // the strip and its fitted pages stay, the page is scrolled to the top at the next paint
+        m_isDoublePage = false;
+        pendingStripPage = page;
+        this->setCurrentPage_Internal(page);
+        emit this->pageViewConfigUINeedsToBeUpdated();
+        return;
+    }
     if(doublePage == -1){
         m_isDoublePage = false;
         do {
@@ -282,6 +347,14 @@ void PageViewWidget::firstPage()
 
 void PageViewWidget::nextPage(bool slideShow)
 {
+    if(continuousMode)
+    {
+        if(currPage >= this->m_comic->getPageCount())
+            emit requestLoadNextComic();
+        else
+            this->goToPage(currPage + 1);
+        return;
+    }
     //TODO:
     bool isEnd = ( m_isDoublePage && currPage >= this->m_comic->getPageCount()-0)
                ||(!m_isDoublePage && currPage >= this->m_comic->getPageCount()-1);
@@ -319,6 +392,11 @@ void PageViewWidget::previousPage()
         emit requestLoadPrevComic();
         return;
     }
+    if(continuousMode)
+    {
+        this->goToPage(currPage - 1);
+        return;
+    }
     // bool isStart = ;
     int page = currPage -1;
     if(! m_comic->isValidPage(page))
@@ -370,7 +448,7 @@ void PageViewWidget::setFitMode(FitMode mode)
     fitMode = mode;
     if(mode != FitMode::ManualZoom)
     {
-        maintainCache(cacheKey::leftPageTransformed);
+        maintainCache(cacheKey::leftPageFitted);
         fitModeJustChanged = true;
     }
     else
@@ -423,7 +501,7 @@ void PageViewWidget::setCheckeredBackgroundForTransparency(bool checkered)
 {
     checkeredBackgroundForTransparency = checkered;
     emit this->pageViewConfigUINeedsToBeUpdated();
-    maintainCache(cacheKey::leftPageTransformed);
+    maintainCache(cacheKey::leftPageFitted);
 }
 
 void PageViewWidget::setMangaMode(bool enabled)
@@ -458,11 +536,8 @@ void PageViewWidget::setMagnifyingLensEnabled(bool enabled)
 
 void PageViewWidget::currentPageToClipboard()
 {
-    renderCombinedImage = true;
-    this->repaint();
-    renderCombinedImage = false;
-    QApplication::clipboard()->setPixmap(this->cachedCombinedImage);
-    this->cachedCombinedImage = {};
+    if(imgCache.value(cacheKey::leftPageRaw).isNull()) this->repaint();
+    QApplication::clipboard()->setPixmap(renderCombinedPages());
 }
 
 void PageViewWidget::setSmartScroll(bool enabled)
@@ -481,7 +556,16 @@ ComicSource* PageViewWidget::setComicSource(ComicSource* src)
 {
     auto oldComic = m_comic;
 
+    // the background decode still uses the old source, which is deleted by the caller.
+    pendingPageLoads.clear();
+    pageLoadWatcher.waitForFinished();
+    pendingZoomTiles.clear();
+    zoomTileWatcher.waitForFinished();
+    showingPagePreview = false;
+    pageMetadataPending = false;
+
     m_comic = src;
+    if(m_comic) m_comic->setDisplaySize(this->size() * this->devicePixelRatioF());
     emit this->archiveMetadataUpdateNeeded(m_comic? m_comic->getComicMetadata():ComicMetadata{});
 
     maintainCache(cacheKey::dropAll);
@@ -523,6 +607,33 @@ bool PageViewWidget::isMangaMode() const
     return this->mangaMode;
 }
 
+bool PageViewWidget::isContinuousMode() const
+{
+    return this->continuousMode;
+}
+
+void PageViewWidget::setContinuousMode(bool enabled)
+{
+    if(continuousMode == enabled)
+        return;
+    continuousMode = enabled;
+    stripSlices.clear();
+    stripLayoutWidth = -1;
+    emit this->pageViewConfigUINeedsToBeUpdated();
+
+    // go to the same page again, so it ends up at the top of the strip or gets its double page state back
+    const int page = currPage;
+    if(m_comic && m_comic->isValidPage(page - 1))
+    {
+        currPage = 0;
+        this->goToPage(page);
+    }
+    else
+    {
+        update();
+    }
+}
+
 bool PageViewWidget::stretchesSmallImages() const
 {
     return this->stretchSmallImages;
@@ -582,16 +693,20 @@ QString PageViewWidget::currentPageFilePath()
 
 void PageViewWidget::setHorizontalScrollPosition(int pos)
 {
+    stopScrollAnimation();
+    const int oldX = currentX;
     this->currentX = pos;
     ensureDisplacementWithinAllowedBounds();
-    update();
+    scrollContents(oldX, currentY);
 }
 
 void PageViewWidget::setVerticalScrollPosition(int pos)
 {
+    stopScrollAnimation();
+    const int oldY = currentY;
     this->currentY = pos;
     ensureDisplacementWithinAllowedBounds();
-    update();
+    scrollContents(currentX, oldY);
 }
 
 void PageViewWidget::resetTransformation(bool force)
@@ -614,42 +729,48 @@ void PageViewWidget::resetTransformation(bool force)
                 emit this->fitModeChanged(fitMode);
             }
         }
-        maintainCache(cacheKey::leftPageTransformed);
+        maintainCache(cacheKey::leftPageFitted);
         this->currentX = 0;
         this->currentXWasReset = true;
         this->currentY = 0;
     }
 }
 
-QPixmap PageViewWidget::getRegionFromCombinedPixmap(const QPixmap& left, const QPixmap& right, int x, int y, int w, int h, const QColor& bkgColor)
+QRect PageViewWidget::lensRect(const QPoint& pos) const
 {
-    int combined_height = std::max(left.height(), right.height());
-    int rightYOffset = (combined_height - right.height()) / 2.0;
-    int leftYOffset = (combined_height - left.height()) / 2.0;
-    int leftX = 0, leftY = 0, leftW = 0, leftH = 0, rightX = 0, rightY = 0, rightW = 0, rightH = 0;
-    if(x < left.width())
-    {
-        leftX = x;
-        leftW = std::min(left.width() - x, w);
-        rightW = w - leftW;
-    }
-    else
-    {
-        rightX = x - left.width();
-        rightW = w;
-    }
-    leftY = y - leftYOffset;
-    leftH = y - leftYOffset + h;
-    rightY = y - rightYOffset;
-    rightH = y - rightYOffset + h;
+    return QRect(pos.x() - magnifyingLensSize / 2, pos.y() - magnifyingLensSize / 2, magnifyingLensSize, magnifyingLensSize);
+}
 
-    QPixmap res(w, h);
-    QPainter p(&res);
-    p.fillRect(res.rect(), bkgColor);
-    if(leftW > 0 && leftH > 0) p.drawPixmap(QPointF(0, std::max(0, -leftY)), left, QRectF(leftX, leftY, leftW, leftH));
-    if(rightW > 0 && rightH > 0) p.drawPixmap(QPointF(leftW, std::max(0, -rightY)), right, QRectF(rightX, rightY, rightW, rightH));
-    p.end();
-    return res;
+QTransform PageViewWidget::rawPageToWidgetTransform(const QPixmap& raw, const QRect& pageRect) const
+{
+    QTransform orient;
+    orient.rotate(rotationDegree);
+    orient.scale(horizontalFlip ? -1.0 : 1.0, verticalFlip ? -1.0 : 1.0);
+    orient = QPixmap::trueMatrix(orient, raw.width(), raw.height());
+    const QSize oriented = orientedPageSize(raw);
+    return orient
+           * QTransform::fromScale(double(pageRect.width()) / oriented.width(), double(pageRect.height()) / oriented.height())
+           * QTransform::fromTranslate(pageRect.x(), pageRect.y());
+}
+
+void PageViewWidget::drawLensPage(QPainter& painter, const QPixmap& raw, const QRect& pageRect)
+{
+    if(raw.isNull() || pageRect.isEmpty()) return;
+
+    const double k = 1.0 / magnificationFactor;
+    const QTransform lens = QTransform::fromTranslate(-mousePos.x(), -mousePos.y())
+                            * QTransform::fromScale(k, k)
+                            * QTransform::fromTranslate(mousePos.x(), mousePos.y());
+    const QTransform full = rawPageToWidgetTransform(raw, pageRect) * lens;
+
+    // part of the raw page under the lens
+    const QRect needed = full.inverted().mapRect(QRectF(lensRect(mousePos))).toAlignedRect() & raw.rect();
+    if(needed.isEmpty()) return;
+
+    // drawn straight from the raw page, only the part under the lens is sampled
+    painter.setTransform(full);
+    painter.drawPixmap(QRectF(needed), raw, QRectF(needed));
+    painter.resetTransform();
 }
 
 void PageViewWidget::fitLeftRightImageToSize(int width, int height, int combined_width, int combined_height, double& leftScaledWidth, double& rightScaledWidth, double& leftScaledHeight, double& rightScaledHeight)
@@ -677,7 +798,7 @@ void PageViewWidget::fitLeftRightImageToSize(int width, int height, int combined
         rightScaledHeight *= proportion;
     }
 
-    if(stretchSmallImages && !shrunk)
+    if((stretchSmallImages || showingPagePreview) && !shrunk)
     {
         proportion = width / double(combined_width);
         if(proportion * combined_height > height)
@@ -783,14 +904,23 @@ void preparePageBeforeUpdate_getpage(void){
     //transform:
 }
 
+EdgeColorHistogram PageViewWidget::getPageEdgeColors(int pageNum, const QPixmap& raw) const
+{
+    // mangaMode may have swapped the raw pixmaps, which doesn't matter as the histograms are merged
+    EdgeColorHistogram hist;
+    if(!showingPagePreview) hist = ImageCache::cache().getEdgeColors({m_comic->getID(), pageNum});
+    if(hist.isEmpty()) hist = EdgeColorHistogram::fromImage(raw.toImage(), MainWindow::getEdgeColorStep());
+    return hist;
+}
+
 void PageViewWidget::paintEvent(QPaintEvent* event)
 {
-    //check comicsource
-    if(this->m_comic == nullptr || !m_comic->isValidPage(this->currPage - 1))
-        return;
-    //check this
-    if(active == false){
-        QWidget::paintEvent(event);
+    //check comicsource, the widget is opaque so the background still has to be painted
+    if(this->m_comic == nullptr || !m_comic->isValidPage(this->currPage - 1) || active == false)
+    {
+        QPainter painter(this);
+        QColor bkg(mainViewBackground);
+        painter.fillRect(event->rect(), bkg.isValid() ? bkg : this->palette().color(QPalette::Window));
         return;
     }
     QElapsedTimer x;
@@ -804,11 +934,17 @@ void PageViewWidget::paintEvent(QPaintEvent* event)
     auto b = QColor(mainViewBackground);
     auto c = this->palette().color(QPalette::Window);
     color = a.isValid()? a : (b.isValid()?b:c);
-    painter.fillRect(painter.viewport(), color);
+    painter.fillRect(event->rect(), color);
     finalBkgColor = color;
 
     // >>-- 1. calculate background color. ....end...
 
+    if(continuousMode)
+    {
+        paintContinuousStrip(painter, event->rect(), finalBkgColor);
+        return;
+    }
+
     int width = this->width();
     int height = this->height();
     int targetX = 0;
@@ -816,13 +952,13 @@ void PageViewWidget::paintEvent(QPaintEvent* event)
 
     // -- 2. compute imgCache[pageRaw] data.
     if(imgCache[cacheKey::leftPageRaw].isNull()) {
-        imgCache[cacheKey::leftPageRaw] = m_comic->getPagePixmap(currPage - 1);
+        imgCache[cacheKey::leftPageRaw] = getPagePixmapOrPreview(currPage - 1);
     }
 
     bool doublePage = m_isDoublePage;
     if(doublePage && imgCache[cacheKey::rightPageRaw].isNull())
     {
-        imgCache[cacheKey::rightPageRaw] = m_comic->getPagePixmap(currPage);
+        imgCache[cacheKey::rightPageRaw] = getPagePixmapOrPreview(currPage);
 
         if(mangaMode)
         {
@@ -830,126 +966,52 @@ void PageViewWidget::paintEvent(QPaintEvent* event)
         }
     }
 
-    // -- 3. compute imgCache[pageTransformed], if rotation and flip needed.
-    if(imgCache[cacheKey::leftPageTransformed].isNull() || (!dynamicBackground.isValid() && mainViewBackground == "dynamic"))
+    if(showingPagePreview && (imgCache[cacheKey::leftPageRaw].isNull() || (doublePage && imgCache[cacheKey::rightPageRaw].isNull())))
     {
-        QTransform transform;
-        transform.rotate(rotationDegree);
-        transform.scale(horizontalFlip ? -1.0 : 1.0, verticalFlip ? -1.0 : 1.0);
-
-        imgCache[cacheKey::leftPageTransformed] = imgCache[cacheKey::leftPageRaw]
-                                .transformed(transform, hqTransformMode
-                                                    ? Qt::SmoothTransformation
-                                                    : Qt::FastTransformation);
-        if(doublePage)
-            imgCache[cacheKey::rightPageTransformed] = imgCache[cacheKey::rightPageRaw]
-                                .transformed(transform, hqTransformMode
-                                                        ? Qt::SmoothTransformation
-                                                        : Qt::FastTransformation);
-
-        if(!dynamicBackground.isValid() && mainViewBackground == "dynamic")
-        {
-            dynamicBackground = MainWindow::getMostCommonEdgeColor(imgCache[cacheKey::leftPageTransformed].toImage(), imgCache[cacheKey::rightPageTransformed].toImage());
-            painter.fillRect(painter.viewport(), dynamicBackground);
-            finalBkgColor = dynamicBackground;
-        }
-
-        QPixmap leftBkg, rightBkg;
-        if(checkeredBackgroundForTransparency)
-        {
-            leftBkg = getCheckeredBackground(imgCache[cacheKey::leftPageTransformed].size());
-            if(doublePage){
-                rightBkg = getCheckeredBackground(imgCache[cacheKey::rightPageTransformed].size());
-            }
-        }
-        else
-        {
-            leftBkg = QPixmap(imgCache[cacheKey::leftPageTransformed].size());
-            leftBkg.fill(Qt::transparent);
-            if(doublePage) {
-                rightBkg = QPixmap(imgCache[cacheKey::rightPageTransformed].size());
-                rightBkg.fill(Qt::transparent);
-            }
-        }
-        QPainter leftPainter(&leftBkg);
-        leftPainter.drawPixmap(0, 0, imgCache[cacheKey::leftPageTransformed]);
-        leftPainter.end();
-
-        if(doublePage)
-        {
-            QPainter rightPainter(&rightBkg);
-            rightPainter.drawPixmap(0, 0, imgCache[cacheKey::rightPageTransformed]);
-            rightPainter.end();
-        }
-
-        imgCache[cacheKey::leftPageTransformed] = leftBkg;
-        imgCache[cacheKey::rightPageTransformed] = rightBkg;
-        updtWindowIcon = true;
+        // no stand-in available, keep the background until the decode finishes.
+        imgCache.remove(cacheKey::leftPageRaw);
+        imgCache.remove(cacheKey::rightPageRaw);
+        return;
     }
 
-    if(updtWindowIcon)
+    if(!dynamicBackground.isValid() && mainViewBackground == "dynamic")
     {
-        emit windowIconUpdateNeeded(imgCache[cacheKey::leftPageTransformed]);
-        updtWindowIcon = false;
+        // rotating or flipping only permutes the edges, so the raw pages give the same result
+        dynamicBackground = EdgeColorHistogram::mostCommonColor(
+            getPageEdgeColors(currPage - 1, imgCache[cacheKey::leftPageRaw]),
+            doublePage ? getPageEdgeColors(currPage, imgCache[cacheKey::rightPageRaw]) : EdgeColorHistogram{});
+        painter.fillRect(event->rect(), dynamicBackground);
+        finalBkgColor = dynamicBackground;
     }
 
-    auto combined_width = imgCache[cacheKey::leftPageTransformed].width() + imgCache[cacheKey::rightPageTransformed].width();
-    auto combined_height = std::max(imgCache[cacheKey::leftPageTransformed].height(), imgCache[cacheKey::rightPageTransformed].height());
-
-    // -- extra, save current presented image to clipboard.
-    if(renderCombinedImage)
-    {
-        QPixmap img_combined;
-
-        if(checkeredBackgroundForTransparency)
-        {
-            img_combined = getCheckeredBackground({combined_width, combined_height});
-        }
-        else
-        {
-            img_combined = QPixmap(combined_width, combined_height);
-            img_combined.fill(Qt::transparent);
-        }
-
-        QPainter combined_painter(&img_combined);
-
-        combined_painter.drawPixmap(0,
-                                    (img_combined.height() - imgCache[cacheKey::leftPageTransformed].height()) / 2.0,
-                                    imgCache[cacheKey::leftPageTransformed]);
-        if(!imgCache[cacheKey::rightPageTransformed].isNull()){
-            //combined_painter.
-            combined_painter.setPen(Qt::black);
-            combined_painter.drawLine(  imgCache[cacheKey::leftPageTransformed].width(),
-                                        (img_combined.height() - imgCache[cacheKey::rightPageTransformed].height()) / 2.0,
-                                        imgCache[cacheKey::leftPageTransformed].width(),
-                                        this->height());
-            combined_painter.drawPixmap(imgCache[cacheKey::leftPageTransformed].width(),
-                                        (img_combined.height() - imgCache[cacheKey::rightPageTransformed].height()) / 2.0,
-                                        imgCache[cacheKey::rightPageTransformed]);
-        }
-        combined_painter.end();
-        cachedCombinedImage = img_combined;
-    }
+    // -- 3. rotation and flips are applied after fitting, to the much smaller fitted pages,
+    // so only the oriented sizes of the raw pages are needed here.
+    const QSize leftSize = orientedPageSize(imgCache[cacheKey::leftPageRaw]);
+    const QSize rightSize = orientedPageSize(imgCache[cacheKey::rightPageRaw]);
+    auto combined_width = leftSize.width() + rightSize.width();
+    auto combined_height = std::max(leftSize.height(), rightSize.height());
 
     // -- 4. compute imgCache[pageFitted].
     auto scaleMode = hqTransformMode ? Qt::SmoothTransformation : Qt::FastTransformation;
+    // previews are much smaller than the real page, always blow them up to the final size.
+    const bool stretch = stretchSmallImages || showingPagePreview;
 
-    if(imgCache[cacheKey::leftPageFitted].isNull())
+    if(imgCache[cacheKey::leftPageFitted].isNull() && !zoomTiledSize[0].isValid())
     {
         if(fitMode == FitMode::FitHeight)
         {
             int temp = height;
             height *= calcZoomScaleFactor();
-            if(imgCache[cacheKey::leftPageTransformed].height() > height || stretchSmallImages) {
-                imgCache[cacheKey::leftPageFitted] = imgCache[cacheKey::leftPageTransformed].scaledToHeight(height, scaleMode);
+            if(leftSize.height() > height || stretch) {
+                imgCache[cacheKey::leftPageFitted] = fitPageToHeight(imgCache[cacheKey::leftPageRaw], height, scaleMode);
             } else {
-                imgCache[cacheKey::leftPageFitted] = imgCache[cacheKey::leftPageTransformed];
+                imgCache[cacheKey::leftPageFitted] = transformPage(imgCache[cacheKey::leftPageRaw]);
             }
 
-            if(imgCache[cacheKey::rightPageTransformed].height() > height || stretchSmallImages) {
-                imgCache[cacheKey::rightPageFitted] = imgCache[cacheKey::rightPageTransformed].scaledToHeight(height, scaleMode);
+            if(rightSize.height() > height || stretch) {
+                imgCache[cacheKey::rightPageFitted] = fitPageToHeight(imgCache[cacheKey::rightPageRaw], height, scaleMode);
             } else {
-                imgCache[cacheKey::rightPageFitted] = imgCache[cacheKey::rightPageTransformed];
+                imgCache[cacheKey::rightPageFitted] = transformPage(imgCache[cacheKey::rightPageRaw]);
             }
             cachedZoomBaseLeftImageSize = imgCache[cacheKey::leftPageFitted].size();
             cachedZoomBaseRightImageSize = imgCache[cacheKey::rightPageFitted].size();
@@ -959,26 +1021,26 @@ void PageViewWidget::paintEvent(QPaintEvent* event)
         {
             int temp = width;
             width *= calcZoomScaleFactor();
-            if(combined_width > width || stretchSmallImages)
+            if(combined_width > width || stretch)
             {
-                double leftProportion = double(imgCache[cacheKey::leftPageTransformed].width()) / double(combined_width);
+                double leftProportion = double(leftSize.width()) / double(combined_width);
                 int leftScaledWidth = width * leftProportion;
                 int rightScaledWidth = width - leftScaledWidth;
-                if(imgCache[cacheKey::rightPageTransformed].isNull())
+                if(rightSize.isEmpty())
                 {
                     rightScaledWidth = 0;
                     leftScaledWidth = width;
                 }
-                imgCache[cacheKey::leftPageFitted] = imgCache[cacheKey::leftPageTransformed].scaledToWidth(
+                imgCache[cacheKey::leftPageFitted] = fitPageToWidth(imgCache[cacheKey::leftPageRaw],
                                                         leftScaledWidth, scaleMode);
                 if(doublePage)
-                    imgCache[cacheKey::rightPageFitted] = imgCache[cacheKey::rightPageTransformed].scaledToWidth(
+                    imgCache[cacheKey::rightPageFitted] = fitPageToWidth(imgCache[cacheKey::rightPageRaw],
                                                                 rightScaledWidth, scaleMode);
             }
             else
             {
-                imgCache[cacheKey::leftPageFitted] = imgCache[cacheKey::leftPageTransformed];
-                imgCache[cacheKey::rightPageFitted] = imgCache[cacheKey::rightPageTransformed];
+                imgCache[cacheKey::leftPageFitted] = transformPage(imgCache[cacheKey::leftPageRaw]);
+                imgCache[cacheKey::rightPageFitted] = transformPage(imgCache[cacheKey::rightPageRaw]);
             }
             cachedZoomBaseLeftImageSize = imgCache[cacheKey::leftPageFitted].size();
             cachedZoomBaseRightImageSize = imgCache[cacheKey::rightPageFitted].size();
@@ -986,25 +1048,25 @@ void PageViewWidget::paintEvent(QPaintEvent* event)
         }
         else if(fitMode == FitMode::FitBest)
         {
-            if(!(combined_width < width && combined_height < height) || stretchSmallImages)
+            if(!(combined_width < width && combined_height < height) || stretch)
             {
-                double leftScaledWidth = imgCache[cacheKey::leftPageTransformed].width();
-                double rightScaledWidth = imgCache[cacheKey::rightPageTransformed].width();
-                double leftScaledHeight = imgCache[cacheKey::leftPageTransformed].height();
-                double rightScaledHeight = imgCache[cacheKey::rightPageTransformed].height();
+                double leftScaledWidth = leftSize.width();
+                double rightScaledWidth = rightSize.width();
+                double leftScaledHeight = leftSize.height();
+                double rightScaledHeight = rightSize.height();
 
                 fitLeftRightImageToSize(width, height,
                                         combined_width, combined_height,
                                         leftScaledWidth, rightScaledWidth,
                                         leftScaledHeight, rightScaledHeight);
 
-                imgCache[cacheKey::leftPageFitted] = imgCache[cacheKey::leftPageTransformed].scaled(
+                imgCache[cacheKey::leftPageFitted] = fitPage(imgCache[cacheKey::leftPageRaw],
                                                             leftScaledWidth,
                                                             leftScaledHeight,
                                                             Qt::IgnoreAspectRatio,
                                                             scaleMode);
                 if(doublePage)
-                    imgCache[cacheKey::rightPageFitted] = imgCache[cacheKey::rightPageTransformed].scaled(
+                    imgCache[cacheKey::rightPageFitted] = fitPage(imgCache[cacheKey::rightPageRaw],
                                                                 rightScaledWidth,
                                                                 rightScaledHeight,
                                                                 Qt::IgnoreAspectRatio,
@@ -1012,50 +1074,48 @@ void PageViewWidget::paintEvent(QPaintEvent* event)
             }
             else
             {
-                imgCache[cacheKey::leftPageFitted] = imgCache[cacheKey::leftPageTransformed];
-                imgCache[cacheKey::rightPageFitted] = imgCache[cacheKey::rightPageTransformed];
+                imgCache[cacheKey::leftPageFitted] = transformPage(imgCache[cacheKey::leftPageRaw]);
+                imgCache[cacheKey::rightPageFitted] = transformPage(imgCache[cacheKey::rightPageRaw]);
             }
             cachedZoomBaseLeftImageSize = imgCache[cacheKey::leftPageFitted].size();
             cachedZoomBaseRightImageSize = imgCache[cacheKey::rightPageFitted].size();
         }
         else if(fitMode == FitMode::OriginalSize)
         {
-            imgCache[cacheKey::leftPageFitted] = imgCache[cacheKey::leftPageTransformed];
-            imgCache[cacheKey::rightPageFitted] = imgCache[cacheKey::rightPageTransformed];
+            imgCache[cacheKey::leftPageFitted] = transformPage(imgCache[cacheKey::leftPageRaw]);
+            imgCache[cacheKey::rightPageFitted] = transformPage(imgCache[cacheKey::rightPageRaw]);
             cachedZoomBaseLeftImageSize = imgCache[cacheKey::leftPageFitted].size();
             cachedZoomBaseRightImageSize = imgCache[cacheKey::rightPageFitted].size();
         }
         else if(fitMode == FitMode::FixedSize)
         {
-            if(!(combined_width < fixedSizeWidth && combined_height < fixedSizeHeight) || stretchSmallImages)
+            if(!(combined_width < fixedSizeWidth && combined_height < fixedSizeHeight) || stretch)
             {
-                double leftScaledWidth = imgCache[cacheKey::leftPageTransformed].width();
-                double rightScaledWidth = imgCache[cacheKey::rightPageTransformed].width();
-                double leftScaledHeight = imgCache[cacheKey::leftPageTransformed].height();
-                double rightScaledHeight = imgCache[cacheKey::rightPageTransformed].height();
+                double leftScaledWidth = leftSize.width();
+                double rightScaledWidth = rightSize.width();
+                double leftScaledHeight = leftSize.height();
+                double rightScaledHeight = rightSize.height();
 
                 fitLeftRightImageToSize(fixedSizeWidth, fixedSizeHeight,
                                         combined_width, combined_height,
                                         leftScaledWidth, rightScaledWidth,
                                         leftScaledHeight, rightScaledHeight);
 
-                imgCache[cacheKey::leftPageFitted] = imgCache[cacheKey::leftPageTransformed]
-                                            .scaled(leftScaledWidth,
+                imgCache[cacheKey::leftPageFitted] = fitPage(imgCache[cacheKey::leftPageRaw], leftScaledWidth,
                                                     leftScaledHeight,
                                                     Qt::IgnoreAspectRatio,
                                                     scaleMode);
                 if(doublePage)
-                    imgCache[cacheKey::rightPageFitted] = imgCache[cacheKey::rightPageTransformed]
-                                            .scaled(rightScaledWidth,
+                    imgCache[cacheKey::rightPageFitted] = fitPage(imgCache[cacheKey::rightPageRaw], rightScaledWidth,
                                                     rightScaledHeight,
                                                     Qt::IgnoreAspectRatio,
                                                     scaleMode);
             }
             else
             {
-                imgCache[cacheKey::leftPageFitted] = imgCache[cacheKey::leftPageTransformed];
+                imgCache[cacheKey::leftPageFitted] = transformPage(imgCache[cacheKey::leftPageRaw]);
                 if(doublePage)
-                    imgCache[cacheKey::rightPageFitted] = imgCache[cacheKey::rightPageTransformed];
+                    imgCache[cacheKey::rightPageFitted] = transformPage(imgCache[cacheKey::rightPageRaw]);
             }
             cachedZoomBaseLeftImageSize = imgCache[cacheKey::leftPageFitted].size();
             cachedZoomBaseRightImageSize = imgCache[cacheKey::rightPageFitted].size();
@@ -1064,37 +1124,57 @@ void PageViewWidget::paintEvent(QPaintEvent* event)
         {
             auto zoomScaleFactor = calcZoomScaleFactor();
             auto zoomBaseLeftImageSize = cachedZoomBaseLeftImageSize.isNull()
-                                            ? imgCache[cacheKey::leftPageTransformed].size()
+                                            ? leftSize
                                             : cachedZoomBaseLeftImageSize;
             auto zoomBaseRightImageSize = cachedZoomBaseRightImageSize.isNull()
-                                    ? imgCache[cacheKey::rightPageTransformed].size()
+                                    ? rightSize
                                     : cachedZoomBaseRightImageSize;
 
-            imgCache[cacheKey::leftPageFitted] = imgCache[cacheKey::leftPageTransformed].scaled(
+            const QSize leftTarget = leftSize.scaled(zoomScaleFactor * zoomBaseLeftImageSize.width(),
+                                                     zoomScaleFactor * zoomBaseLeftImageSize.height(), Qt::KeepAspectRatio);
+            if(zoomTilesApply(0, leftTarget))
+                zoomTiledSize[0] = leftTarget;
+            else
+                imgCache[cacheKey::leftPageFitted] = fitPage(imgCache[cacheKey::leftPageRaw],
                                             zoomScaleFactor * zoomBaseLeftImageSize.width(),
                                             zoomScaleFactor * zoomBaseLeftImageSize.height(),
                                             Qt::KeepAspectRatio,
                                             hqTransformMode ? Qt::SmoothTransformation : Qt::FastTransformation);
 
             if(doublePage)
-                imgCache[cacheKey::rightPageFitted] = imgCache[cacheKey::rightPageTransformed].scaled(
+            {
+                const QSize rightTarget = rightSize.scaled(zoomScaleFactor * zoomBaseRightImageSize.width(),
+                                                           zoomScaleFactor * zoomBaseRightImageSize.height(), Qt::KeepAspectRatio);
+                if(zoomTilesApply(1, rightTarget))
+                    zoomTiledSize[1] = rightTarget;
+                else
+                    imgCache[cacheKey::rightPageFitted] = fitPage(imgCache[cacheKey::rightPageRaw],
                                             zoomScaleFactor * zoomBaseRightImageSize.width(),
                                             zoomScaleFactor * zoomBaseRightImageSize.height(),
                                             Qt::KeepAspectRatio,
                                             hqTransformMode ? Qt::SmoothTransformation : Qt::FastTransformation);
+            }
         }
     }
 
-    combined_width = imgCache[cacheKey::leftPageFitted].width() + imgCache[cacheKey::rightPageFitted].width();
-    combined_height = std::max(imgCache[cacheKey::leftPageFitted].height(), imgCache[cacheKey::rightPageFitted].height());
-    if(lastDrawnLeftHeight != imgCache[cacheKey::leftPageFitted].height())
+    if(updtWindowIcon)
+    {
+        emit windowIconUpdateNeeded(zoomTiledSize[0].isValid() ? imgCache[cacheKey::leftPageRaw] : imgCache[cacheKey::leftPageFitted]);
+        updtWindowIcon = false;
+    }
+
+    const QSize leftFittedSize = fittedPageSize(0);
+    const QSize rightFittedSize = fittedPageSize(1);
+    combined_width = leftFittedSize.width() + rightFittedSize.width();
+    combined_height = std::max(leftFittedSize.height(), rightFittedSize.height());
+    if(lastDrawnLeftHeight != leftFittedSize.height())
     {
-        lastDrawnLeftHeight = imgCache[cacheKey::leftPageFitted].height();
+        lastDrawnLeftHeight = leftFittedSize.height();
         emitStatusbarUpdateSignal();
     }
-    if(lastDrawnRightHeight != imgCache[cacheKey::rightPageFitted].height())
+    if(lastDrawnRightHeight != rightFittedSize.height())
     {
-        lastDrawnRightHeight = imgCache[cacheKey::rightPageFitted].height();
+        lastDrawnRightHeight = rightFittedSize.height();
         emitStatusbarUpdateSignal();
     }
 
@@ -1137,32 +1217,318 @@ void PageViewWidget::paintEvent(QPaintEvent* event)
     emit this->updateHorizontalScrollBar(allowedXDisplacement, currentX, std::min(width, combined_width));
     emit this->updateVerticalScrollBar(allowedYDisplacement, currentY, std::min(height, combined_height));
 
-    painter.drawPixmap(targetX - currentX, targetY - currentY + (combined_height - imgCache[cacheKey::leftPageFitted].height()) / 2.0, imgCache[cacheKey::leftPageFitted]);
-    if(!imgCache[cacheKey::rightPageFitted].isNull())
+    lastDrawnImageFullSize = QSize(combined_width, combined_height);
+
+    leftPageRect = QRect(QPoint(targetX - currentX, targetY - currentY + (combined_height - leftFittedSize.height()) / 2.0),
+                         leftFittedSize);
+    rightPageRect = QRect(QPoint(leftPageRect.right() + 1, targetY - currentY + (combined_height - rightFittedSize.height()) / 2.0),
+                          rightFittedSize);
+
+    if(zoomTiledSize[0].isValid())
+        drawZoomTiles(painter, 0, leftPageRect, event->rect());
+    else
+        painter.drawPixmap(targetX - currentX, targetY - currentY + (combined_height - leftFittedSize.height()) / 2.0, imgCache[cacheKey::leftPageFitted]);
+    if(zoomTiledSize[1].isValid())
+    {
+        drawZoomTiles(painter, 1, rightPageRect, event->rect());
+    }
+    else if(!imgCache[cacheKey::rightPageFitted].isNull())
     {
-        painter.drawPixmap(targetX - currentX + imgCache[cacheKey::leftPageFitted].width(), targetY - currentY + (combined_height - imgCache[cacheKey::rightPageFitted].height()) / 2.0, imgCache[cacheKey::rightPageFitted]);
+        painter.drawPixmap(targetX - currentX + leftFittedSize.width(), targetY - currentY + (combined_height - rightFittedSize.height()) / 2.0, imgCache[cacheKey::rightPageFitted]);
     }
 
-    lastDrawnImageFullSize = QSize(combined_width, combined_height);
+    if(magnify && mouseCurrentlyOverWidget)
+    {
+        // sampled from the raw pages, so the lens shows real detail instead of enlarged fitted pixels
+        const QRect lens = lensRect(mousePos);
+        painter.fillRect(lens, finalBkgColor);
+        painter.save();
+        painter.setClipRect(lens);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, magnifyingLensHQScaling);
+        drawLensPage(painter, imgCache[cacheKey::leftPageRaw], leftPageRect);
+        drawLensPage(painter, imgCache[cacheKey::rightPageRaw], rightPageRect);
+        painter.restore();
+        painter.setPen(Qt::black);
+        painter.drawRect(lens);
+    }
+}
+
+void PageViewWidget::paintContinuousStrip(QPainter& painter, const QRect& exposed, const QColor& background)
+{
+    const int count = m_comic->getPageCount();
+    if(stripPageSizes.size() != count)
+    {
+        stripPageSizes = QVector<QSize>(count);
+        stripOffsets.clear();
+        stripLayoutWidth = -1;
+    }
+
+    const int stripWidth = std::max(1, int(this->width() * calcZoomScaleFactor()));
+    bool layoutChanged = false;
+    if(stripLayoutWidth != stripWidth)
+    {
+        layoutStrip(stripWidth);
+        layoutChanged = true;
+    }
+    if(pendingStripPage > 0)
+    {
+        currentY = stripOffsets[pendingStripPage - 1];
+        pendingStripPage = 0;
+        layoutChanged = true;
+    }
+
+    // read the real sizes of the pages around the viewport from their headers, the rest of the
+    // strip stays estimated; every correction can move other pages into the viewport
+    const int margin = this->height();
+    for(int pass = 0; pass < 4; pass++)
+    {
+        bool sizesChanged = false;
+        const int last = stripPageAt(currentY + this->height() + margin);
+        for(int i = stripPageAt(currentY - margin); i <= last; i++)
+        {
+            if(stripPageSizes[i].isValid())
+                continue;
+            stripPageSizes[i] = m_comic->getPageSize(i);
+            sizesChanged |= stripPageSizes[i].isValid();
+        }
+        if(!sizesChanged)
+            break;
+        layoutStrip(stripWidth);
+        layoutChanged = true;
+    }
+
+    const int totalHeight = stripOffsets.back();
+    allowedXDisplacement = std::max(0, stripWidth - this->width());
+    allowedYDisplacement = std::max(0, totalHeight - this->height());
+    draggingXEnabled = allowedXDisplacement > 0;
+    draggingYEnabled = allowedYDisplacement > 0;
+    ensureDisplacementWithinAllowedBounds();
+    const int targetX = std::max(0, (this->width() - stripWidth) / 2) - currentX;
+    const int targetY = std::max(0, (this->height() - totalHeight) / 2) - currentY;
+
+    // slices that left the window are dropped, the decoded pages stay in ImageCache
+    const int first = stripPageAt(-targetY - margin);
+    const int last = stripPageAt(-targetY + this->height() + margin);
+    for(auto it = stripSlices.begin(); it != stripSlices.end();)
+    {
+        if(it.key() < first || it.key() > last)
+            it = stripSlices.erase(it);
+        else
+            ++it;
+    }
+
+    auto scaleMode = hqTransformMode ? Qt::SmoothTransformation : Qt::FastTransformation;
+    bool sizeCorrected = false;
+    for(int i = first; i <= last; i++)
+    {
+        const QRect target(targetX, targetY + stripOffsets[i], stripWidth, stripOffsets[i + 1] - stripOffsets[i]);
+        const bool visible = target.intersects(this->rect());
+        auto slice = stripSlices.constFind(i);
+        if(slice == stripSlices.cend())
+        {
+            if(m_comic->hasPagePixmap(i) || (visible && !progressivePageLoading))
+            {
+                const QPixmap raw = m_comic->getPagePixmap(i);
+                if(!raw.isNull() && raw.size() != stripPageSizes[i])
+                {
+                    stripPageSizes[i] = raw.size();
+                    sizeCorrected = true;
+                }
+                // a page that failed to decode is kept as a null slice, so it isn't tried on every paint
+                slice = stripSlices.insert(i, fitPageToWidth(raw, stripWidth, scaleMode));
+            }
+            else
+            {
+                requestPageLoad(i);
+            }
+        }
+        if(!visible || !target.intersects(exposed))
+            continue;
+        if(slice != stripSlices.cend())
+        {
+            painter.drawPixmap(target.topLeft(), *slice);
+        }
+        else if(auto preview = m_comic->ComicSource::getPagePreview(i); !preview.isNull())
+        {
+            // only the thumbnail, decoding a reduced preview here would stall scrolling
+            painter.drawPixmap(target, transformPage(preview));
+        }
+    }
 
     if(magnify && mouseCurrentlyOverWidget)
     {
-        auto sourceLength = magnificationFactor * magnifyingLensSize;
-        QPixmap sourceImg = getRegionFromCombinedPixmap(imgCache[cacheKey::leftPageFitted], imgCache[cacheKey::rightPageFitted],
-                                                        mousePos.x() - targetX + currentX - sourceLength / 2.0,
-                                                        mousePos.y() - targetY + currentY - sourceLength / 2.0,
-                                                        sourceLength, sourceLength, finalBkgColor)
-                              .scaled(magnifyingLensSize, magnifyingLensSize, Qt::IgnoreAspectRatio,
-                                      magnifyingLensHQScaling ? Qt::SmoothTransformation : Qt::FastTransformation);
-        painter.fillRect(mousePos.x() - magnifyingLensSize / 2.0, mousePos.y() - magnifyingLensSize / 2.0, magnifyingLensSize, magnifyingLensSize, finalBkgColor);
-        painter.drawPixmap(mousePos.x() - magnifyingLensSize / 2.0, mousePos.y() - magnifyingLensSize / 2.0, sourceImg);
+        const QRect lens = lensRect(mousePos);
+        painter.fillRect(lens, background);
+        painter.save();
+        painter.setClipRect(lens);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, magnifyingLensHQScaling);
+        const int lensLast = stripPageAt(lens.bottom() - targetY);
+        for(int i = stripPageAt(lens.top() - targetY); i <= lensLast; i++)
+        {
+            if(m_comic->hasPagePixmap(i))
+                drawLensPage(painter, m_comic->getPagePixmap(i),
+                             QRect(targetX, targetY + stripOffsets[i], stripWidth, stripOffsets[i + 1] - stripOffsets[i]));
+        }
+        painter.restore();
         painter.setPen(Qt::black);
-        painter.drawRect(mousePos.x() - magnifyingLensSize / 2.0, mousePos.y() - magnifyingLensSize / 2.0, magnifyingLensSize, magnifyingLensSize);
+        painter.drawRect(lens);
     }
+
+    lastDrawnImageFullSize = QSize(stripWidth, totalHeight);
+    emit this->updateHorizontalScrollBar(allowedXDisplacement, currentX, std::min(this->width(), stripWidth));
+    emit this->updateVerticalScrollBar(allowedYDisplacement, currentY, std::min(this->height(), totalHeight));
+
+    // the page at the top of the viewport is the current page, the same one goToPage scrolls to.
+    // pages that fit below the end of the strip can't reach the top, there the one goToPage chose is kept.
+    const int topPage = stripPageAt(-targetY) + 1;
+    const bool atEnd = currentY >= allowedYDisplacement && currPage > topPage && targetY + stripOffsets[currPage - 1] < this->height();
+    if(topPage != currPage && !atEnd)
+        setStripCurrentPage(topPage);
+    if(updtWindowIcon && !stripSlices.value(currPage - 1).isNull())
+    {
+        emit windowIconUpdateNeeded(stripSlices.value(currPage - 1));
+        updtWindowIcon = false;
+    }
+
+    if(sizeCorrected)
+        layoutStrip(stripWidth);
+    // a partial paint after scroll() only covers the exposed area, the rest is stale if pages moved
+    if(sizeCorrected || (layoutChanged && exposed != this->rect()))
+        update();
+}
+
+void PageViewWidget::layoutStrip(int stripWidth)
+{
+    // keep the page at the top of the viewport in place while the pages above it change size
+    int anchorPage = -1;
+    double anchorFraction = 0;
+    if(stripOffsets.size() == stripPageSizes.size() + 1 && stripOffsets.size() > 1)
+    {
+        anchorPage = stripPageAt(currentY);
+        anchorFraction = double(currentY - stripOffsets[anchorPage]) / (stripOffsets[anchorPage + 1] - stripOffsets[anchorPage]);
+    }
+    if(stripWidth != stripLayoutWidth)
+        stripSlices.clear();
+    stripLayoutWidth = stripWidth;
+
+    // pages whose size is not known yet get the aspect ratio of the nearest known page above them
+    const int count = stripPageSizes.size();
+    double aspect = 1.414;
+    for(const auto& size: std::as_const(stripPageSizes))
+    {
+        if(!size.isEmpty())
+        {
+            const QSize oriented = ImageTransform::orientedSize(size, rotationDegree);
+            aspect = double(oriented.height()) / oriented.width();
+            break;
+        }
+    }
+    stripOffsets.resize(count + 1);
+    stripOffsets[0] = 0;
+    for(int i = 0; i < count; i++)
+    {
+        const QSize size = ImageTransform::orientedSize(stripPageSizes[i], rotationDegree);
+        if(!size.isEmpty())
+            aspect = double(size.height()) / size.width();
+        stripOffsets[i + 1] = stripOffsets[i] + std::max(1, qRound(stripWidth * aspect));
+    }
+
+    if(anchorPage >= 0)
+    {
+        const int oldY = currentY;
+        currentY = stripOffsets[anchorPage] + qRound(anchorFraction * (stripOffsets[anchorPage + 1] - stripOffsets[anchorPage]));
+        // a running scroll animation moves along with the content
+        scrollAnimationFrom.ry() += currentY - oldY;
+        scrollAnimationTarget.ry() += currentY - oldY;
+    }
+}
+
+int PageViewWidget::stripPageAt(int y) const
+{
+    auto it = std::upper_bound(stripOffsets.cbegin(), stripOffsets.cend(), y);
+    return std::clamp(int(it - stripOffsets.cbegin()) - 1, 0, stripOffsets.size() - 2);
+}
+
+void PageViewWidget::setStripCurrentPage(int page)
+{
+    // like setCurrentPage_Internal, but the strip and its fitted pages stay as they are
+    currPage = page;
+    pageMetadataPending = !currentPagesDecoded();
+    emit this->currentPageChanged(m_comic->getFilePath(), currPage, m_comic->getPageCount());
+
+    updtWindowIcon = true;
+    if(this->thumbsWidget)
+        this->thumbsWidget->setCurrentPage(page);
+    this->updateImageMetadata();
+    emit this->pageViewConfigUINeedsToBeUpdated();
+}
+
+QPixmap PageViewWidget::getPagePixmapOrPreview(int pageNum)
+{
+    if(!progressivePageLoading || m_comic->hasPagePixmap(pageNum))
+        return m_comic->getPagePixmap(pageNum);
+
+    requestPageLoad(pageNum);
+    showingPagePreview = true;
+    return m_comic->getPagePreview(pageNum);
+}
+
+void PageViewWidget::requestPageLoad(int pageNum)
+{
+    if(!pendingPageLoads.contains(pageNum))
+        pendingPageLoads.append(pageNum);
+    startPendingPageLoads();
+}
+
+void PageViewWidget::startPendingPageLoads()
+{
+    if(pendingPageLoads.isEmpty() || pageLoadWatcher.isRunning())
+        return;
+
+    auto comic = m_comic;
+    auto pages = pendingPageLoads;
+    pendingPageLoads.clear();
+    pageLoadWatcher.setFuture(QtConcurrent::run([comic, pages]() {
+        // getPagePixmap puts the result into ImageCache.
+        for(int page: pages)
+            comic->getPagePixmap(page);
+    }));
+}
+
+void PageViewWidget::onPageLoadFinished()
+{
+    startPendingPageLoads();
+    if(continuousMode)
+    {
+        // the next paint fits the pages that just got decoded
+        update();
+    }
+    else if(showingPagePreview)
+    {
+        // repaint from the raw stage, which picks up the decoded pages
+        // or shows the preview again if they are still not there.
+        maintainCache(cacheKey::leftPageRaw);
+    }
+    if(pageMetadataPending && currentPagesDecoded())
+    {
+        pageMetadataPending = false;
+        updateImageMetadata();
+    }
+}
+
+bool PageViewWidget::currentPagesDecoded() const
+{
+    if(!m_comic || !m_comic->isValidPage(currPage - 1))
+        return true;
+    if(!m_comic->hasPagePixmap(currPage - 1))
+        return false;
+    return !m_isDoublePage || !m_comic->isValidPage(currPage) || m_comic->hasPagePixmap(currPage);
 }
 
 void PageViewWidget::mousePressEvent(QMouseEvent* event)
 {
+    // dragging takes over from where the animation currently is
+    stopScrollAnimation();
     dragging = true;
     currentXWasReset = false;
     dragStartX = currentX + event->x();
@@ -1186,6 +1552,8 @@ void PageViewWidget::mouseMoveEvent(QMouseEvent* event)
 {
     if(dragging)
     {
+        const int oldX = currentX;
+        const int oldY = currentY;
         currentXWasReset = false;
         if(draggingXEnabled || allowFreeDrag)
         {
@@ -1196,12 +1564,14 @@ void PageViewWidget::mouseMoveEvent(QMouseEvent* event)
             currentY = dragStartY - event->y();
         }
         ensureDisplacementWithinAllowedBounds();
-        if(draggingXEnabled || draggingYEnabled || allowFreeDrag) update();
+        if(draggingXEnabled || draggingYEnabled || allowFreeDrag) scrollContents(oldX, oldY);
     }
     if(magnify)
     {
+        // only the area the lens left and the area it now covers need repainting
+        const QRect oldLens = lensRect(mousePos);
         mousePos = event->pos();
-        update();
+        update((oldLens | lensRect(mousePos)).adjusted(-1, -1, 2, 2));
     }
 }
 
@@ -1285,14 +1655,28 @@ void PageViewWidget::leaveEvent(QEvent*)
 
 void PageViewWidget::resizeEvent(QResizeEvent*)
 {
+    displaySizeTimer.start();
     if(fitModeJustChanged) maintainCache(cacheKey::leftPageFitted);
     fitModeJustChanged = false;
 }
 
+void PageViewWidget::onDisplaySizeSettled()
+{
+    if(!m_comic) return;
+    m_comic->setDisplaySize(this->size() * this->devicePixelRatioF());
+
+    // pages rendered for a smaller window are rendered again at the resolution of the new size
+    bool stale = false;
+    for(int page: {currPage - 1, currPage})
+        if(m_comic->isValidPage(page) && m_comic->isScalablePage(page) && !m_comic->hasPagePixmap(page)) stale = true;
+    if(stale) maintainCache(continuousMode ? cacheKey::leftPageFitted : cacheKey::leftPageRaw);
+}
+
 void PageViewWidget::scrollInDirection(ScrollDirection direction,
                                        PageViewWidget::ScrollSource src)
 {
     auto scrollPx = 0;
+    beginScrollStep();
     currentXWasReset = false;
     if(src == ScrollSource::WheelScroll)
     {
@@ -1317,6 +1701,15 @@ void PageViewWidget::scrollInDirection(ScrollDirection direction,
     {
         if(!useAdaptiveSlideShowScroll) scrollPx = slideShowScrollPixels;
     }
+    if(continuousMode)
+    {
+        // the whole comic is one page here, a space press moves by a screen and not by the strip height
+        if(src == ScrollSource::SpaceScroll && !useAdaptiveSpaceScroll) scrollPx = this->height() * spaceScrollFraction;
+        if(scrollPx <= 0) scrollPx = getAdaptiveScrollPixels(direction);
+        scrollStrip(direction, scrollPx, src);
+        endScrollStep();
+        return;
+    }
     if(direction == ScrollDirection::Down && currentY <= allowedYDisplacement)
     {
         if(currentFlipSteps < 0)
@@ -1408,11 +1801,162 @@ void PageViewWidget::scrollInDirection(ScrollDirection direction,
         currentFlipSteps = 0;
         if(flipPagesByScrolling) previousPage();
     }
-    update();
+    endScrollStep();
+}
+
+void PageViewWidget::scrollContents(int oldX, int oldY)
+{
+    const int dx = oldX - currentX;
+    const int dy = oldY - currentY;
+    if(dx == 0 && dy == 0) return;
+
+    // moving the pixels is only valid if the last paint used the current fitted pages
+    const bool fitted = continuousMode ? !stripSlices.isEmpty() : !imgCache.value(cacheKey::leftPageFitted).isNull() || zoomTiledSize[0].isValid();
+    if(!fitted || std::abs(dx) >= width() || std::abs(dy) >= height())
+    {
+        update();
+        return;
+    }
+    scroll(dx, dy);
+    if(magnify && mouseCurrentlyOverWidget)
+    {
+        // the lens stays under the cursor, repaint where it is and where the scroll moved its old image
+        const QRect lens = lensRect(mousePos).adjusted(-1, -1, 2, 2);
+        update(lens | lens.translated(dx, dy));
+    }
+}
+
+void PageViewWidget::scrollStrip(ScrollDirection direction, int scrollPx, ScrollSource src)
+{
+    const int oldY = currentY;
+    const bool vertical = direction == ScrollDirection::Up || direction == ScrollDirection::Down;
+    const bool forward = direction == ScrollDirection::Down || direction == ScrollDirection::Right;
+    if(vertical)
+        currentY += forward ? scrollPx : -scrollPx;
+    else
+        currentX += forward ? scrollPx : -scrollPx;
+    ensureDisplacementWithinAllowedBounds();
+
+    if(vertical && currentY == oldY)
+    {
+        // pushing against either end of the strip continues with the next or previous comic
+        if(forward != (currentFlipSteps > 0)) currentFlipSteps = 0;
+        currentFlipSteps += forward ? 1 : -1;
+        if(src == ScrollSource::SlideShowScroll && forward) currentFlipSteps = stepsBeforePageFlip;
+        if(std::abs(currentFlipSteps) >= stepsBeforePageFlip)
+        {
+            currentFlipSteps = 0;
+            if(forward && (flipPagesByScrolling || src == ScrollSource::SlideShowScroll))
+                emit requestLoadNextComic();
+            else if(!forward && flipPagesByScrolling)
+                emit requestLoadPrevComic();
+        }
+        return;
+    }
+    currentFlipSteps = 0;
+}
+
+void PageViewWidget::beginScrollStep()
+{
+    // smart scrolling can move several times per step, only the outermost call animates
+    if(scrollStepDepth++ > 0)
+        return;
+    scrollStepShownPos = QPoint(currentX, currentY);
+    scrollStepInterrupted = false;
+    if(scrollAnimationTimer.isActive())
+    {
+        // the step continues from where the running animation was heading, not from what is on screen
+        scrollAnimationTimer.stop();
+        currentX = scrollAnimationTarget.x();
+        currentY = scrollAnimationTarget.y();
+    }
+}
+
+void PageViewWidget::endScrollStep()
+{
+    if(--scrollStepDepth > 0)
+        return;
+    if(scrollStepInterrupted)
+        update();
+    else
+        animateScrollFrom(scrollStepShownPos);
+}
+
+void PageViewWidget::animateScrollFrom(const QPoint& from)
+{
+    const QPoint to(currentX, currentY);
+    if(!smoothScrolling || smoothScrollDuration <= 0 || from == to)
+    {
+        scrollContents(from.x(), from.y());
+        return;
+    }
+
+    scrollAnimationFrom = from;
+    scrollAnimationTarget = to;
+    currentX = from.x();
+    currentY = from.y();
+
+    // one step per display refresh, the position is computed from the elapsed time so late frames catch up
+    QScreen* screen = this->window()->windowHandle() ? this->window()->windowHandle()->screen() : QGuiApplication::primaryScreen();
+    const double refreshRate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : 60.0;
+    scrollFrameIntervalNs = qint64(1e9 / refreshRate);
+    lastScrollFrameNs = 0;
+    scrollAnimationClock.start();
+    scrollAnimationTimer.start(std::max(1, int(1000.0 / refreshRate)));
+}
+
+void PageViewWidget::onScrollAnimationFrame()
+{
+    const qint64 elapsed = scrollAnimationClock.nsecsElapsed();
+    const qint64 frameNs = elapsed - lastScrollFrameNs;
+    lastScrollFrameNs = elapsed;
+    scrollFrames++;
+    totalScrollFrameNs += frameNs;
+    worstScrollFrameNs = std::max(worstScrollFrameNs, frameNs);
+    if(frameNs > scrollFrameIntervalNs * 3 / 2)
+        droppedScrollFrames += int(frameNs / scrollFrameIntervalNs) - 1;
+
+    // ease out: most of the distance is covered in the first frames, so the scroll still feels immediate
+    const double t = std::min(1.0, double(elapsed) / (smoothScrollDuration * 1000000.0));
+    const double eased = 1.0 - std::pow(1.0 - t, 3);
+    const int oldX = currentX;
+    const int oldY = currentY;
+    currentX = scrollAnimationFrom.x() + qRound((scrollAnimationTarget.x() - scrollAnimationFrom.x()) * eased);
+    currentY = scrollAnimationFrom.y() + qRound((scrollAnimationTarget.y() - scrollAnimationFrom.y()) * eased);
+    ensureDisplacementWithinAllowedBounds();
+    if(t >= 1.0)
+        scrollAnimationTimer.stop();
+    // every frame only moves the pixels already on screen and paints the newly exposed band
+    scrollContents(oldX, oldY);
+}
+
+void PageViewWidget::stopScrollAnimation()
+{
+    scrollAnimationTimer.stop();
+    scrollStepInterrupted = true;
+}
+
+PageViewWidget::ScrollFrameStatistics PageViewWidget::scrollFrameStatistics() const
+{
+    ScrollFrameStatistics stats;
+    stats.frames = scrollFrames;
+    stats.droppedFrames = droppedScrollFrames;
+    stats.averageFrameMs = scrollFrames > 0 ? totalScrollFrameNs / 1000000.0 / scrollFrames : 0;
+    stats.worstFrameMs = worstScrollFrameNs / 1000000.0;
+    return stats;
+}
+
+void PageViewWidget::resetScrollFrameStatistics()
+{
+    scrollFrames = 0;
+    droppedScrollFrames = 0;
+    totalScrollFrameNs = 0;
+    worstScrollFrameNs = 0;
 }
 
 void PageViewWidget::scrollNext(PageViewWidget::ScrollSource src)
 {
+    beginScrollStep();
     if(smartScroll)
     {
         if(mangaMode)
@@ -1478,10 +2022,12 @@ void PageViewWidget::scrollNext(PageViewWidget::ScrollSource src)
     {
         scrollInDirection(ScrollDirection::Down, src);
     }
+    endScrollStep();
 }
 
 void PageViewWidget::scrollPrev(PageViewWidget::ScrollSource src)
 {
+    beginScrollStep();
     if(smartScroll)
     {
         if(mangaMode)
@@ -1547,6 +2093,7 @@ void PageViewWidget::scrollPrev(PageViewWidget::ScrollSource src)
     {
         scrollInDirection(ScrollDirection::Up, src);
     }
+    endScrollStep();
 }
 
 // check the pageNo. the page width/height.
@@ -1646,6 +2193,10 @@ void PageViewWidget::ensureDisplacementWithinAllowedBounds()
 
 void PageViewWidget::updateImageMetadata()
 {
+    // metadata of a page that is not decoded yet would force a decode on the GUI thread.
+    if(pageMetadataPending)
+        return;
+
     auto metadata1 = PageMetadata{};
     auto metadata2 = PageMetadata{};
     if(m_comic && m_comic->getPageCount() > 0 && currPage > 0)
@@ -1665,8 +2216,11 @@ void PageViewWidget::updateImageMetadata()
 
 void PageViewWidget::setCurrentPage_Internal(int page)
 {
+    stopScrollAnimation();
     maintainCache(cacheKey::leftPageRaw);
+    pendingPageLoads.clear();
     currPage = page;
+    pageMetadataPending = progressivePageLoading && !currentPagesDecoded();
     emit this->currentPageChanged(m_comic->getFilePath(), currPage, m_comic->getPageCount());
     update();
 
@@ -1684,6 +2238,9 @@ double PageViewWidget::calcZoomScaleFactor()
 
 void PageViewWidget::emitStatusbarUpdateSignal()
 {
+    if(pageMetadataPending)
+        return;
+
     auto metadata1 = PageMetadata{};
     auto metadata2 = PageMetadata{};
 
@@ -1709,6 +2266,103 @@ void PageViewWidget::emitStatusbarUpdateSignal()
     emit this->statusbarUpdate(fitMode, metadata1, metadata2, lastDrawnLeftHeight, lastDrawnRightHeight, swappedLeftRight);
 }
 
+QPixmap PageViewWidget::transformPage(const QPixmap& page) const
+{
+    const bool checkered = checkeredBackgroundForTransparency && page.hasAlphaChannel();
+    if(ImageTransform::isIdentity(rotationDegree, horizontalFlip, verticalFlip) && !checkered) return page;
+
+    QImage img;
+    if(ImageTransform::isRightAngle(rotationDegree))
+    {
+        img = ImageTransform::oriented(page.toImage(), rotationDegree, horizontalFlip, verticalFlip);
+    }
+    else
+    {
+        QTransform transform;
+        transform.rotate(rotationDegree);
+        transform.scale(horizontalFlip ? -1.0 : 1.0, verticalFlip ? -1.0 : 1.0);
+        img = page.toImage().transformed(transform, hqTransformMode ? Qt::SmoothTransformation : Qt::FastTransformation);
+    }
+
+    if(checkered)
+    {
+        // the checkers go behind the page in the same buffer instead of into a separate background pixmap
+        if(img.format() != QImage::Format_ARGB32_Premultiplied) img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        QPainter painter(&img);
+        painter.setCompositionMode(QPainter::CompositionMode_DestinationOver);
+        painter.drawTiledPixmap(img.rect(), checkeredBkg);
+    }
+    return QPixmap::fromImage(std::move(img), Qt::NoFormatConversion);
+}
+
+QSize PageViewWidget::orientedPageSize(const QPixmap& page) const
+{
+    if(page.isNull()) return {};
+    if(ImageTransform::isRightAngle(rotationDegree)) return ImageTransform::orientedSize(page.size(), rotationDegree);
+    QTransform transform;
+    transform.rotate(rotationDegree);
+    transform.scale(horizontalFlip ? -1.0 : 1.0, verticalFlip ? -1.0 : 1.0);
+    return transform.mapRect(page.rect()).size();
+}
+
+QPixmap PageViewWidget::fitPage(const QPixmap& page, int w, int h, Qt::AspectRatioMode aspectMode, Qt::TransformationMode mode) const
+{
+    if(page.isNull()) return {};
+    if(!ImageTransform::isRightAngle(rotationDegree))
+        return ImageScaler::scaled(transformPage(page), w, h, aspectMode, mode);
+
+    // scale the raw page to the pre-rotation equivalent of the target size, then orient the small result
+    const QSize target = orientedPageSize(page).scaled(w, h, aspectMode);
+    const QSize rawTarget = ImageTransform::orientedSize(target, rotationDegree);
+    return transformPage(ImageScaler::scaled(page, rawTarget.width(), rawTarget.height(), Qt::IgnoreAspectRatio, mode));
+}
+
+QPixmap PageViewWidget::fitPageToWidth(const QPixmap& page, int w, Qt::TransformationMode mode) const
+{
+    const QSize size = orientedPageSize(page);
+    if(size.isEmpty() || w <= 0) return {};
+    return fitPage(page, w, std::max(1, qRound(double(size.height()) * w / size.width())), Qt::IgnoreAspectRatio, mode);
+}
+
+QPixmap PageViewWidget::fitPageToHeight(const QPixmap& page, int h, Qt::TransformationMode mode) const
+{
+    const QSize size = orientedPageSize(page);
+    if(size.isEmpty() || h <= 0) return {};
+    return fitPage(page, std::max(1, qRound(double(size.width()) * h / size.height())), h, Qt::IgnoreAspectRatio, mode);
+}
+
+QPixmap PageViewWidget::renderCombinedPages()
+{
+    // only built when copying to the clipboard, the full resolution oriented pages are dropped again right after
+    const QPixmap left = transformPage(imgCache.value(cacheKey::leftPageRaw));
+    const QPixmap right = transformPage(imgCache.value(cacheKey::rightPageRaw));
+    if(left.isNull()) return {};
+    const int combined_width = left.width() + right.width();
+    const int combined_height = std::max(left.height(), right.height());
+
+    QPixmap img_combined;
+    if(checkeredBackgroundForTransparency)
+    {
+        img_combined = getCheckeredBackground({combined_width, combined_height});
+    }
+    else
+    {
+        img_combined = QPixmap(combined_width, combined_height);
+        img_combined.fill(Qt::transparent);
+    }
+
+    QPainter combined_painter(&img_combined);
+    combined_painter.drawPixmap(0, (img_combined.height() - left.height()) / 2.0, left);
+    if(!right.isNull())
+    {
+        combined_painter.setPen(Qt::black);
+        combined_painter.drawLine(left.width(), (img_combined.height() - right.height()) / 2.0, left.width(), this->height());
+        combined_painter.drawPixmap(left.width(), (img_combined.height() - right.height()) / 2.0, right);
+    }
+    combined_painter.end();
+    return img_combined;
+}
+
 QPixmap PageViewWidget::getCheckeredBackground(const QSize &backgroundsize)
 {
     QPixmap res(backgroundsize);
@@ -1723,14 +2377,150 @@ QPixmap PageViewWidget::getCheckeredBackground(const QSize &backgroundsize)
     return res;
 }
 
+void PageViewWidget::releaseFittedPages()
+{
+    maintainCache(cacheKey::leftPageFitted);
+}
+
+int PageViewWidget::pageOnSide(int side) const
+{
+    // the left page is the later one of a manga spread
+    const bool swapped = mangaMode && m_isDoublePage;
+    return (side == 0) != swapped ? currPage - 1 : currPage;
+}
+
+bool PageViewWidget::zoomTilesApply(int side, const QSize& target)
+{
+    const QPixmap& raw = imgCache[side == 0 ? cacheKey::leftPageRaw : cacheKey::rightPageRaw];
+    if(fitMode != FitMode::ManualZoom || raw.isNull() || showingPagePreview || target.isEmpty()) return false;
+    if(!ImageTransform::isIdentity(rotationDegree, horizontalFlip, verticalFlip)) return false;
+    // below the raw resolution the downscaled fitted pixmap is as sharp as it gets and cheap to keep
+    if(target.width() <= raw.width() && target.height() <= raw.height()) return false;
+    return m_comic && m_comic->isScalablePage(pageOnSide(side));
+}
+
+QSize PageViewWidget::fittedPageSize(int side)
+{
+    if(zoomTiledSize[side].isValid()) return zoomTiledSize[side];
+    return imgCache[side == 0 ? cacheKey::leftPageFitted : cacheKey::rightPageFitted].size();
+}
+
+void PageViewWidget::drawZoomTiles(QPainter& painter, int side, const QRect& pageRect, const QRect& exposed)
+{
+    const int page = pageOnSide(side);
+    const QSize pageSize = zoomTiledSize[side];
+    const QPixmap& raw = imgCache[side == 0 ? cacheKey::leftPageRaw : cacheKey::rightPageRaw];
+    const QRect visible = exposed.intersected(pageRect).translated(-pageRect.topLeft());
+    if(visible.isEmpty()) return;
+
+    const int firstX = visible.left() / ZOOM_TILE_SIZE * ZOOM_TILE_SIZE;
+    const int firstY = visible.top() / ZOOM_TILE_SIZE * ZOOM_TILE_SIZE;
+    bool requested = false;
+    for(int y = firstY; y <= visible.bottom(); y += ZOOM_TILE_SIZE)
+    {
+        for(int x = firstX; x <= visible.right(); x += ZOOM_TILE_SIZE)
+        {
+            const QRect tile = QRect(x, y, ZOOM_TILE_SIZE, ZOOM_TILE_SIZE).intersected(QRect(QPoint(0, 0), pageSize));
+            const ZoomTileKey key{{page, {pageSize.width(), pageSize.height()}}, {x, y}};
+            const QPixmap pixmap = zoomTiles.value(key);
+            if(!pixmap.isNull())
+            {
+                painter.drawPixmap(tile.translated(pageRect.topLeft()).topLeft(), pixmap);
+                continue;
+            }
+
+            // until the tile arrives the matching region of the raw page is stretched over it
+            const double sx = double(raw.width()) / pageSize.width();
+            const double sy = double(raw.height()) / pageSize.height();
+            const QRectF source(tile.x() * sx, tile.y() * sy, tile.width() * sx, tile.height() * sy);
+            painter.save();
+            painter.setRenderHint(QPainter::SmoothPixmapTransform, hqTransformMode);
+            painter.drawPixmap(QRectF(tile.translated(pageRect.topLeft())), raw, source);
+            painter.restore();
+
+            if(!requestedZoomTiles.contains(key))
+            {
+                requestedZoomTiles.insert(key);
+                pendingZoomTiles.append({page, pageSize, tile, {}});
+                requested = true;
+            }
+        }
+    }
+    if(requested) startZoomTileRenders();
+}
+
+void PageViewWidget::startZoomTileRenders()
+{
+    if(pendingZoomTiles.isEmpty() || zoomTileWatcher.isRunning())
+        return;
+
+    auto comic = m_comic;
+    auto tiles = pendingZoomTiles;
+    pendingZoomTiles.clear();
+    zoomTileWatcher.setFuture(QtConcurrent::run([comic, tiles]() mutable {
+        for(auto& tile: tiles)
+            tile.image = comic->renderPageRegion(tile.page, tile.pageSize, tile.rect);
+        return tiles;
+    }));
+}
+
+void PageViewWidget::onZoomTilesRendered()
+{
+    const auto tiles = zoomTileWatcher.result();
+    for(const auto& tile: tiles)
+    {
+        const ZoomTileKey key{{tile.page, {tile.pageSize.width(), tile.pageSize.height()}}, {tile.rect.x(), tile.rect.y()}};
+        // a page change while the batch was rendering forgets the requests, a zoom change keeps them
+        if(!requestedZoomTiles.contains(key)) continue;
+        // a failed tile stays requested, so it is not rendered again and again on every paint
+        if(tile.image.isNull()) continue;
+        requestedZoomTiles.remove(key);
+        zoomTiles.insert(key, QPixmap::fromImage(tile.image, Qt::NoFormatConversion));
+        zoomTileOrder.append(key);
+    }
+    while(zoomTileOrder.size() > MAX_ZOOM_TILES)
+        zoomTiles.remove(zoomTileOrder.takeFirst());
+
+    startZoomTileRenders();
+    update();
+}
+
+void PageViewWidget::dropPendingZoomTiles()
+{
+    zoomTiledSize[0] = {};
+    zoomTiledSize[1] = {};
+    // tiles of the previous zoom that did not start rendering are not needed anymore
+    for(const auto& tile: pendingZoomTiles)
+        requestedZoomTiles.remove({{tile.page, {tile.pageSize.width(), tile.pageSize.height()}}, {tile.rect.x(), tile.rect.y()}});
+    pendingZoomTiles.clear();
+}
+
+void PageViewWidget::clearZoomTiles()
+{
+    zoomTiledSize[0] = {};
+    zoomTiledSize[1] = {};
+    zoomTiles.clear();
+    zoomTileOrder.clear();
+    requestedZoomTiles.clear();
+    pendingZoomTiles.clear();
+}
+
 void PageViewWidget::maintainCache(PageViewWidget::cacheKey dropKey)
 {
     QMutableMapIterator<cacheKey, QPixmap> it(imgCache);
     switch(dropKey)
     {
         case cacheKey::dropAll:
+            stopScrollAnimation();
+            stripPageSizes.clear();
+            stripOffsets.clear();
+            stripSlices.clear();
+            stripLayoutWidth = -1;
+            [[fallthrough]];
         case cacheKey::leftPageRaw:
         case cacheKey::rightPageRaw:
+            showingPagePreview = false;
+            clearZoomTiles();
             while(it.hasNext())
             {
                 it.next();
@@ -1738,20 +2528,13 @@ void PageViewWidget::maintainCache(PageViewWidget::cacheKey dropKey)
                 it.remove();
             }
             break;
-        case cacheKey::leftPageTransformed:
-        case cacheKey::rightPageTransformed:
-            while(it.hasNext())
-            {
-                it.next();
-                if(static_cast<int>(it.key()) >= static_cast<int>(cacheKey::leftPageTransformed))
-                {
-                    it.value() = {};
-                    it.remove();
-                }
-            }
-            break;
         case cacheKey::leftPageFitted:
         case cacheKey::rightPageFitted:
+            // the strip is fitted per page, its layout depends on the zoom and the orientation too
+            stopScrollAnimation();
+            stripSlices.clear();
+            stripLayoutWidth = -1;
+            dropPendingZoomTiles();
             while(it.hasNext())
             {
                 it.next();
@@ -20,13 +20,20 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define PAGEVIEWWIDGET_H
 
 #include "metadata.h"
+#include "edgecolor.h"
 #include <QMouseEvent>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QTransform>
+#include <QHash>
+#include <QSet>
 #include <QWidget>
 #include <QDebug>
 
 class ComicSource;
 class ThumbnailWidget;
+class QPainter;
 
 class PageViewWidget : public QWidget
 {
@@ -59,6 +66,15 @@ public:
         Right
     };
 
+    // timing of the animated scroll frames, a frame counts as dropped for every refresh interval it was late
+    struct ScrollFrameStatistics
+    {
+        int frames = 0;
+        int droppedFrames = 0;
+        double averageFrameMs = 0;
+        double worstFrameMs = 0;
+    };
+
     static FitMode stringToFitMode(const QString& str);
     static QString fitmodeToStr(FitMode);
 
@@ -71,6 +87,7 @@ public:
     bool horizontallyFlipped() const;
     bool isDoublePageMode() const;
     bool isMangaMode() const;
+    bool isContinuousMode() const;
     bool stretchesSmallImages() const;
     bool smartScrollVerticalFirst() const;
     bool smartScrollEnabled() const;
@@ -85,6 +102,10 @@ public:
     QString getFitMode() const {
         return fitmodeToStr(fitMode);
     }
+    ScrollFrameStatistics scrollFrameStatistics() const;
+    void resetScrollFrameStatistics();
+    // drops the fitted pages and strip slices, they are made again on the next paint
+    void releaseFittedPages();
 
     void onCustomContextMenuRequested(const QPoint &);
 
@@ -92,7 +113,7 @@ signals:
     void zoomLevelChanged(int x);
     void windowIconUpdateNeeded(QPixmap);
     void archiveMetadataUpdateNeeded(ComicMetadata);
-    void imageMetadataUpdated(PageMetadata, PageMetadata);
+    void imageMetadataUpdated(const PageMetadata&, const PageMetadata&);
     void currentPageChanged(const QString&, int cur, int total);
     void fitModeChanged(PageViewWidget::FitMode);
     void updateHorizontalScrollBar(int, int, int);
@@ -112,6 +133,8 @@ public slots:
                         -1, calculate by self.
         */
     void goToPage(int page, int doublePage = -1);
+    // pages were added to or removed from the end of the source, the others kept their numbers
+    void pageCountChanged();
     void nextPage(bool slideShow = false);
     void previousPage();
     void rotate(int degree);
@@ -130,6 +153,7 @@ public slots:
     void setCheckeredBackgroundForTransparency(bool checkered);
     void setMangaMode(bool enabled);
     void setDoublePageMode(bool doublePage);
+    void setContinuousMode(bool enabled);
     void setMagnifyingLensEnabled(bool enabled);
     void currentPageToClipboard();
     void setSmartScroll(bool enabled);
@@ -152,6 +176,13 @@ private:
     void scrollInDirection(ScrollDirection direction, ScrollSource src);
     void scrollNext(ScrollSource src);
     void scrollPrev(ScrollSource src);
+    void scrollContents(int oldX, int oldY);
+    void scrollStrip(ScrollDirection direction, int scrollPx, ScrollSource src);
+    void beginScrollStep();
+    void endScrollStep();
+    void animateScrollFrom(const QPoint& from);
+    void onScrollAnimationFrame();
+    void stopScrollAnimation();
     bool currentPageIsSinglePageInDoublePageMode();
     bool isSinglePageByPageMeta(int pagenumber);
     int getAdaptiveScrollPixels(ScrollDirection d);
@@ -162,8 +193,23 @@ private:
     double calcZoomScaleFactor();
     void emitStatusbarUpdateSignal();
     void resetTransformation(bool force = false);
-    static QPixmap getRegionFromCombinedPixmap(const QPixmap& left, const QPixmap& right, int x, int y, int w, int h, const QColor& bkgColor);
+    QPixmap getPagePixmapOrPreview(int pageNum);
+    void requestPageLoad(int pageNum);
+    void startPendingPageLoads();
+    void onPageLoadFinished();
+    // hands the new size to the source once resizing stopped, so a window edge being dragged
+    // doesn't render the pages again at every intermediate resolution
+    void onDisplaySizeSettled();
+    bool currentPagesDecoded() const;
+    EdgeColorHistogram getPageEdgeColors(int pageNum, const QPixmap& raw) const;
+    QRect lensRect(const QPoint& pos) const;
+    QTransform rawPageToWidgetTransform(const QPixmap& raw, const QRect& pageRect) const;
+    void drawLensPage(QPainter& painter, const QPixmap& raw, const QRect& pageRect);
     void doFullRedraw();
+    void paintContinuousStrip(QPainter& painter, const QRect& exposed, const QColor& background);
+    void layoutStrip(int stripWidth);
+    int stripPageAt(int y) const;
+    void setStripCurrentPage(int page);
     bool active = false;
     bool updtWindowIcon = false;
     int rotationDegree = 0;
@@ -226,28 +272,87 @@ private:
     bool slideShowAutoOpenNextComic = false;
     bool mouseCurrentlyOverWidget = false;
     QPoint mousePos;
+    QRect leftPageRect; // where the fitted pages were last drawn, in widget coordinates
+    QRect rightPageRect;
     QPixmap getCheckeredBackground(const QSize &size);
+    QPixmap transformPage(const QPixmap& page) const;
+    QSize orientedPageSize(const QPixmap& page) const;
+    QPixmap fitPage(const QPixmap& page, int w, int h, Qt::AspectRatioMode aspectMode, Qt::TransformationMode mode) const;
+    QPixmap fitPageToWidth(const QPixmap& page, int w, Qt::TransformationMode mode) const;
+    QPixmap fitPageToHeight(const QPixmap& page, int h, Qt::TransformationMode mode) const;
+    QPixmap renderCombinedPages();
     QPixmap checkeredBkg;
     enum class cacheKey //in order, invalidating an entry should invalidate all following entries too
     {
         dropAll = 0,
         leftPageRaw = 1,
         rightPageRaw = 2,
-        leftPageTransformed = 3,
-        rightPageTransformed = 4,
-        leftPageFitted = 5,
-        rightPageFitted = 6,
-        dropNone = 7
+        leftPageFitted = 3, // already rotated and flipped
+        rightPageFitted = 4,
+        dropNone = 5
     };
     QMap<cacheKey, QPixmap> imgCache;
-    bool renderCombinedImage = false;
-    QPixmap cachedCombinedImage;
     void maintainCache(cacheKey dropKey);
     bool fitModeJustChanged = false;
     QSize cachedZoomBaseLeftImageSize;
     QSize cachedZoomBaseRightImageSize;
     QColor dynamicBackground;
     QTimer slideShowTimer;
+    QTimer displaySizeTimer;
+    // animated scrolling: currentX/currentY hold the position on screen and move towards scrollAnimationTarget
+    bool smoothScrolling = false;
+    int smoothScrollDuration = 0;
+    QTimer scrollAnimationTimer;
+    QElapsedTimer scrollAnimationClock;
+    QPoint scrollAnimationFrom;
+    QPoint scrollAnimationTarget;
+    qint64 lastScrollFrameNs = 0;
+    qint64 scrollFrameIntervalNs = 0;
+    int scrollStepDepth = 0;
+    QPoint scrollStepShownPos; // on screen when the outermost scroll step started
+    bool scrollStepInterrupted = false; // the page changed during the step, there is nothing to animate
+    int scrollFrames = 0;
+    int droppedScrollFrames = 0;
+    qint64 totalScrollFrameNs = 0;
+    qint64 worstScrollFrameNs = 0;
+    bool progressivePageLoading = false;
+    bool showingPagePreview = false; // imgCache raw entries hold previews, not the decoded pages
+    bool pageMetadataPending = false;
+    QList<int> pendingPageLoads;
+    // continuous mode: all pages are laid out below each other in one strip of stripLayoutWidth,
+    // only the pages around the viewport are fitted
+    bool continuousMode = false;
+    int stripLayoutWidth = -1; // -1 forces a new layout at the next paint
+    int pendingStripPage = 0; // page to scroll to the top of the viewport at the next paint
+    QVector<QSize> stripPageSizes; // raw page sizes, invalid while unknown
+    QVector<int> stripOffsets; // page i covers [stripOffsets[i], stripOffsets[i + 1]) of the strip
+    QHash<int, QPixmap> stripSlices; // fitted pages in and around the viewport
+    QFutureWatcher<void> pageLoadWatcher;
+    // ManualZoom past the resolution of a scalable (vector) page: instead of one huge upscaled fitted
+    // pixmap, the source renders only the visible tiles at the exact zoom, the fitted entry stays empty
+    struct ZoomTile
+    {
+        int page = -1;
+        QSize pageSize;
+        QRect rect; // in the coordinates of the page at pageSize
+        QImage image;
+    };
+    using ZoomTileKey = QPair<QPair<int, QPair<int, int>>, QPair<int, int>>; // (page, tiled page size), tile origin
+    QSize zoomTiledSize[2]; // invalid for sides drawn from their fitted pixmap
+    // tiles of every zoom level of the shown pages, zooming back and forth does not render them again
+    QHash<ZoomTileKey, QPixmap> zoomTiles;
+    QList<ZoomTileKey> zoomTileOrder; // oldest first
+    QSet<ZoomTileKey> requestedZoomTiles; // rendering or failed, a failed tile stays stretched from the raw page
+    QVector<ZoomTile> pendingZoomTiles;
+    QFutureWatcher<QVector<ZoomTile>> zoomTileWatcher;
+    bool zoomTilesApply(int side, const QSize& target);
+    QSize fittedPageSize(int side);
+    int pageOnSide(int side) const;
+    void drawZoomTiles(QPainter& painter, int side, const QRect& pageRect, const QRect& exposed);
+    void startZoomTileRenders();
+    void onZoomTilesRendered();
+    void dropPendingZoomTiles();
+    void clearZoomTiles();
     ThumbnailWidget* thumbsWidget = nullptr;
 };
 
@@ -1,52 +1,94 @@
 #include "pdfcomicsource.h"
 #include <QDebug>
+#include <QThread>
 #include <memory>
+#include <cmath>
+#include <algorithm>
 #include "imagecache.h"
+#include "grayscale.h"
+#include "diskpagecache.h"
+#include "imagebufferpool.h"
+#include <QBuffer>
+#include <QImageReader>
+#include <QFileInfo>
+
+namespace
+{
+    constexpr int maxRenderDpi = 300;
+    constexpr int minRenderDpi = 36;
+    // resizing the window by a few pixels shouldn't make every page render again
+    constexpr int renderDpiStep = 12;
+
+    QSize renderedSize(const QSizeF& points, int dpi)
+    {
+        return QSize(qRound(points.width() * dpi / 72.0), qRound(points.height() * dpi / 72.0));
+    }
+}
 
 PDFComicSource::PDFComicSource(const QString& path) : FileComicSource(path)
 {
     signatureMimeStr = "application/pdf";
-    m_document = Poppler::Document::load(this->path);
+    auto document = Poppler::Document::load(this->path);
 
-    if(!m_document || m_document->isLocked() ){
+    if(!document || document->isLocked() ){
         qDebug()<<"faile to open, may be it's not a valid pdf file.";
+        delete document;
         return;
     }
+    m_documents.append(document);
+    m_freeDocuments.append(document);
+    // every instance keeps its own parsed objects, a few are enough to keep the cores busy
+    m_maxDocuments = std::clamp(QThread::idealThreadCount(), 1, 4);
+    m_fileVersion = QFileInfo(this->path).lastModified().toSecsSinceEpoch();
 
-    auto len = m_document->numPages();
+    auto len = document->numPages();
     auto charlen = QString::number(len).size();
     for(int i = 0; i< len; i++){
         PageMetadata cur;
         cur.fileName = QString("%1").arg(i, charlen, 10, QLatin1Char('0'));
         m_pageMetaDataList.push_back(cur);
+        std::unique_ptr<Poppler::Page> page(document->page(i));
+        m_pageSizes.push_back(page ? page->pageSizeF() : QSizeF{});
     }
+
+    // if the page trees disagree the file is beyond what the extractor understands
+    m_hasEmbeddedImages = m_embeddedImages.open(this->path) && m_embeddedImages.pageCount() == len;
 }
 
 PDFComicSource::~PDFComicSource()
 {
-    delete m_document;
-    m_document = nullptr;
+    qDeleteAll(m_documents);
 }
 
 int PDFComicSource::getPageCount() const
 {
-    if (!m_document)
-        return 0;
-    return m_document->numPages();
+    return m_pageMetaDataList.size();
 }
 
 QPixmap PDFComicSource::getPagePixmap(int pageNum)
 {
     auto cacheKey = QPair{id, pageNum};
-    if(auto img = ImageCache::cache().getImage(cacheKey); !img.isNull())
+    if(auto img = ImageCache::cache().getImage(cacheKey); !img.isNull() && coversDisplay(pageNum, img))
         return img;
 
-    QMutexLocker lock(&m_openLock);
-    std::unique_ptr<Poppler::Page> page ;
-    page.reset(m_document->page(pageNum));
-    //TODO:
-    //renderToImage(xres, yres)
-    auto img = QPixmap::fromImage(page->renderToImage(300, 300));
+    // scanned pages are decoded from the original JPEG, at native resolution and without Poppler
+    if(auto embedded = Grayscale::toPixmap(decodeEmbeddedImage(pageNum)); !embedded.isNull())
+    {
+        ImageCache::cache().addImage(cacheKey, embedded);
+        return embedded;
+    }
+
+    const int dpi = renderDpi(pageNum, displaySize());
+
+    // reading a rendered page back from disk is much cheaper than rendering it again
+    const QString diskCacheParams = QString("pdf/%1dpi/%2").arg(dpi).arg(m_fileVersion);
+    QImage rendered = DiskPageCache::cache().getImage(id, pageNum, diskCacheParams);
+    if(rendered.isNull())
+    {
+        rendered = renderPage(pageNum, dpi);
+        DiskPageCache::cache().addImage(id, pageNum, diskCacheParams, rendered);
+    }
+    auto img = Grayscale::toPixmap(rendered);
     if(!img.isNull()){
         ImageCache::cache().addImage(cacheKey, img);
     }
@@ -54,6 +96,180 @@ QPixmap PDFComicSource::getPagePixmap(int pageNum)
     return img;
 }
 
+QPixmap PDFComicSource::getPagePixmapForSize(int pageNum, const QSize& target)
+{
+    if(auto embedded = decodeEmbeddedImage(pageNum, target); !embedded.isNull())
+        return Grayscale::toPixmap(embedded);
+    const int dpi = renderDpi(pageNum, target);
+    if(auto img = ImageCache::cache().getImage({id, pageNum}); !img.isNull() && img.width() >= renderedSize(m_pageSizes[pageNum], dpi).width())
+        return img;
+    // not put into ImageCache, it holds pages at display resolution
+    return Grayscale::toPixmap(renderPage(pageNum, dpi));
+}
+
+bool PDFComicSource::hasPagePixmap(int pageNum) const
+{
+    auto img = ImageCache::cache().getImage({id, pageNum});
+    return !img.isNull() && coversDisplay(pageNum, img);
+}
+
+bool PDFComicSource::coversDisplay(int pageNum, const QPixmap& img) const
+{
+    // scanned pages are cached at their native resolution
+    if(m_pageSizes[pageNum].isEmpty() || (m_hasEmbeddedImages && m_embeddedImages.pageImageSize(pageNum).isValid()))
+        return true;
+    // a pixel of slack for rounding in the renderer
+    return img.width() + 1 >= renderedSize(m_pageSizes[pageNum], renderDpi(pageNum, displaySize())).width();
+}
+
+void PDFComicSource::setDisplaySize(const QSize& size)
+{
+    QMutexLocker lock(&m_displaySizeLock);
+    m_displaySize = size;
+}
+
+bool PDFComicSource::isScalablePage(int pageNum)
+{
+    // a scanned page holds no more detail than its image
+    return isValidPage(pageNum) && !m_pageSizes[pageNum].isEmpty()
+           && !(m_hasEmbeddedImages && m_embeddedImages.pageImageSize(pageNum).isValid());
+}
+
+QImage PDFComicSource::renderPageRegion(int pageNum, const QSize& pageSize, const QRect& rect)
+{
+    if(!isScalablePage(pageNum) || pageSize.isEmpty() || rect.isEmpty()) return {};
+    const double xres = 72.0 * pageSize.width() / m_pageSizes[pageNum].width();
+    const double yres = 72.0 * pageSize.height() / m_pageSizes[pageNum].height();
+
+    auto doc = acquireDocument(true);
+    if(!doc) return {};
+    std::unique_ptr<Poppler::Page> page(doc->page(pageNum));
+    // Poppler only rasterizes the requested rectangle of the page at that resolution
+    QImage img = page ? page->renderToImage(xres, yres, rect.x(), rect.y(), rect.width(), rect.height()) : QImage{};
+    page.reset();
+    releaseDocument(doc);
+    return Grayscale::compacted(img);
+}
+
+QImage PDFComicSource::renderPage(int pageNum, int dpi)
+{
+    auto doc = acquireDocument(true);
+    if(!doc) return {};
+    std::unique_ptr<Poppler::Page> page(doc->page(pageNum));
+    QImage img = page ? page->renderToImage(dpi, dpi) : QImage{};
+    page.reset();
+    releaseDocument(doc);
+    return Grayscale::compacted(img);
+}
+
+QImage PDFComicSource::decodeEmbeddedImage(int pageNum, const QSize& target)
+{
+    if(!m_hasEmbeddedImages) return {};
+    QByteArray jpeg = m_embeddedImages.pageJpeg(pageNum);
+    if(jpeg.isEmpty()) return {};
+    if(!target.isValid()) return ImageBufferPool::pool().decode(jpeg);
+
+    // the JPEG decoder skips most of the work for 1/2, 1/4 and 1/8 scale
+    QBuffer buffer(&jpeg);
+    QImageReader reader(&buffer);
+    if(const QSize size = reader.size(); size.width() > target.width() || size.height() > target.height())
+        reader.setScaledSize(size.scaled(target, Qt::KeepAspectRatio));
+    return reader.read();
+}
+
+Poppler::Document* PDFComicSource::acquireDocument(bool wait)
+{
+    if(!wait)
+    {
+        // never waits for a render or for another instance being loaded
+        if(!m_poolLock.tryLock()) return nullptr;
+        auto doc = m_freeDocuments.isEmpty() ? nullptr : m_freeDocuments.takeLast();
+        m_poolLock.unlock();
+        return doc;
+    }
+
+    QMutexLocker lock(&m_poolLock);
+    while(m_freeDocuments.isEmpty())
+    {
+        if(m_documents.isEmpty()) return nullptr;
+        if(m_documents.size() + m_loadingDocuments < m_maxDocuments)
+        {
+            // another instance of the same file. Loading parses the cross reference table, which takes long
+            // for large files, so it happens outside the lock and other threads keep borrowing and returning
+            m_loadingDocuments++;
+            lock.unlock();
+            auto doc = Poppler::Document::load(this->path);
+            if(doc && doc->isLocked())
+            {
+                delete doc;
+                doc = nullptr;
+            }
+            lock.relock();
+            m_loadingDocuments--;
+            if(doc)
+            {
+                m_documents.append(doc);
+                return doc;
+            }
+            m_maxDocuments = m_documents.size();
+            // threads that waited for this instance go back to waiting for a returned one
+            m_documentReleased.wakeAll();
+            continue;
+        }
+        m_documentReleased.wait(&m_poolLock);
+    }
+    return m_freeDocuments.takeLast();
+}
+
+QSize PDFComicSource::displaySize() const
+{
+    QMutexLocker lock(&m_displaySizeLock);
+    return m_displaySize;
+}
+
+void PDFComicSource::releaseDocument(Poppler::Document* doc)
+{
+    QMutexLocker lock(&m_poolLock);
+    m_freeDocuments.append(doc);
+    m_documentReleased.wakeOne();
+}
+
+int PDFComicSource::renderDpi(int pageNum, const QSize& target) const
+{
+    const QSizeF points = isValidPage(pageNum) ? m_pageSizes[pageNum] : QSizeF{};
+    if(points.isEmpty() || target.isEmpty()) return maxRenderDpi;
+    // the larger ratio, so the page is sharp whether it gets fitted to the width or to the height
+    const double dpi = 72.0 * std::max(target.width() / points.width(), target.height() / points.height());
+    const int stepped = int(std::ceil(dpi / renderDpiStep)) * renderDpiStep;
+    return std::clamp(stepped, minRenderDpi, maxRenderDpi);
+}
+
+QPixmap PDFComicSource::getPagePreview(int pageNum)
+{
+    if(auto thumb = ComicSource::getPagePreview(pageNum); !thumb.isNull())
+        return thumb;
+    if(auto embedded = decodeEmbeddedImage(pageNum, m_embeddedImages.pageImageSize(pageNum) / 8); !embedded.isNull())
+        return QPixmap::fromImage(embedded);
+
+    // a 36 dpi render is ~70x cheaper than the full one, but don't block on a running render.
+    auto doc = acquireDocument(false);
+    if(!doc)
+        return {};
+    std::unique_ptr<Poppler::Page> page(doc->page(pageNum));
+    QImage img = page ? page->renderToImage(minRenderDpi, minRenderDpi) : QImage{};
+    page.reset();
+    releaseDocument(doc);
+    return QPixmap::fromImage(img);
+}
+
+QSize PDFComicSource::getPageSize(int pageNum)
+{
+    if(auto size = ComicSource::getPageSize(pageNum); size.isValid()) return size;
+    if(m_hasEmbeddedImages)
+        if(auto size = m_embeddedImages.pageImageSize(pageNum); size.isValid()) return size;
+    return renderedSize(m_pageSizes[pageNum], renderDpi(pageNum, displaySize()));
+}
+
 QString PDFComicSource::getPageFilePath(int pageNum)
 {
     return "virtual";
@@ -62,12 +278,10 @@ QString PDFComicSource::getPageFilePath(int pageNum)
 PageMetadata PDFComicSource::getPageMetadata(int pageNum)
 {
     auto& meta = m_pageMetaDataList[pageNum];
-    if(meta.valid){
-        return meta;
-    }
-    auto px = getPagePixmap(pageNum);
-    meta.width = px.width();
-    meta.height = px.height();
+    // the size follows the render resolution, no need to render for it
+    const QSize size = getPageSize(pageNum);
+    meta.width = size.width();
+    meta.height = size.height();
     meta.fileSize = 0;
     meta.valid = true;
     return meta;
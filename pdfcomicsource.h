@@ -1,6 +1,8 @@
 #pragma once
 
 #include "comicsource.h"
+#include "pdfimageextractor.h"
+#include <QWaitCondition>
 #include <poppler/qt5/poppler-qt5.h>
 #include <poppler/qt5/poppler-version.h>
 
@@ -10,14 +12,46 @@ public:
   PDFComicSource(const QString& path);
   virtual int getPageCount() const override;
   virtual QPixmap getPagePixmap(int pageNum) override;
+  virtual bool hasPagePixmap(int pageNum) const override;
+  virtual QPixmap getPagePixmapForSize(int pageNum, const QSize& target) override;
+  virtual void setDisplaySize(const QSize& size) override;
+  virtual bool isScalablePage(int pageNum) override;
+  virtual QImage renderPageRegion(int pageNum, const QSize& pageSize, const QRect& rect) override;
   virtual QString getPageFilePath(int pageNum) override;
   virtual PageMetadata getPageMetadata(int pageNum) override;
+  virtual QPixmap getPagePreview(int pageNum) override;
+  virtual QSize getPageSize(int pageNum) override;
   // virtual void readNeighborList() override;
   virtual ~PDFComicSource();
 
 private:
+    // a Poppler::Document must not be used by two threads at once, so each rendering thread
+    // borrows its own instance of the same file. Returns nullptr if wait is false and none is free.
+    Poppler::Document* acquireDocument(bool wait);
+    void releaseDocument(Poppler::Document* doc);
+    // the lowest resolution at which the page covers target, within the old fixed 300 dpi
+    int renderDpi(int pageNum, const QSize& target) const;
+    QSize displaySize() const;
+    // a page from ImageCache is only used if it was rendered for a display at least as large as the current one
+    bool coversDisplay(int pageNum, const QPixmap& img) const;
+    QImage renderPage(int pageNum, int dpi);
+    // the embedded JPEG of a scanned page, decoded at reduced size if target is valid. Null for other pages.
+    QImage decodeEmbeddedImage(int pageNum, const QSize& target = {});
     QList<PageMetadata> m_pageMetaDataList{};
-    Poppler::Document *m_document{nullptr};
-    QMutex m_openLock;
-    // QString
+    // page sizes in points, read once so picking a resolution needs no document
+    QVector<QSizeF> m_pageSizes;
+    QVector<Poppler::Document*> m_documents;
+    QVector<Poppler::Document*> m_freeDocuments;
+    int m_maxDocuments = 1;
+    // instances being loaded outside the lock, they count against m_maxDocuments
+    int m_loadingDocuments = 0;
+    QMutex m_poolLock;
+    QWaitCondition m_documentReleased;
+    // own lock, so the GUI thread never waits for the document pool to read it
+    mutable QMutex m_displaySizeLock;
+    QSize m_displaySize;
+    // part of the DiskPageCache key together with the resolution
+    qint64 m_fileVersion = 0;
+    PdfImageExtractor m_embeddedImages;
+    bool m_hasEmbeddedImages = false;
 };
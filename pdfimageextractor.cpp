@@ -0,0 +1,525 @@
+#include "pdfimageextractor.h"
+#include <QDebug>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    constexpr int maxNesting = 32;
+    constexpr int maxReferenceHops = 8;
+
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+    }
+
+    bool isDelimiter(char c)
+    {
+        return isSpace(c) || std::strchr("()<>[]{}/%", c) != nullptr;
+    }
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    // a b c d e f as in the cm operator
+    struct Matrix
+    {
+        double a = 1, b = 0, c = 0, d = 1, e = 0, f = 0;
+
+        // this applied first, then m
+        Matrix then(const Matrix& m) const
+        {
+            return {a * m.a + b * m.c, a * m.b + b * m.d,
+                    c * m.a + d * m.c, c * m.b + d * m.d,
+                    e * m.a + f * m.c + m.e, e * m.b + f * m.d + m.f};
+        }
+    };
+
+    QByteArray inflate(const QByteArray& compressed)
+    {
+        // qUncompress wants the expected size in front and grows its buffer if that is too small
+        QByteArray input(4, '\0');
+        qToBigEndian<quint32>(quint32(std::min<qint64>(qint64(compressed.size()) * 4, std::numeric_limits<int>::max() / 2)), input.data());
+        input.append(compressed);
+        return qUncompress(input);
+    }
+}
+
+PdfImageExtractor::Value PdfImageExtractor::Value::get(const QByteArray& key) const
+{
+    for(const auto& entry: entries)
+        if(entry.first == key) return entry.second;
+    return {};
+}
+
+bool PdfImageExtractor::Value::isName(const char* name) const
+{
+    return type == Type::Name && text == name;
+}
+
+bool PdfImageExtractor::open(const QString& path)
+{
+    file.setFileName(path);
+    if(!file.open(QIODevice::ReadOnly) || file.size() > std::numeric_limits<int>::max()) return false;
+    // the mapping stays for the lifetime of the extractor, only the page tree and the JPEGs are touched
+    auto mapped = file.map(0, file.size());
+    if(!mapped) return false;
+    return parse(QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), int(file.size())));
+}
+
+bool PdfImageExtractor::parse(const QByteArray& data)
+{
+    this->data = data;
+    pages.clear();
+    locations.clear();
+    objectStreams.clear();
+    objectStreamNums.clear();
+    trailer = {};
+
+    const int header = data.indexOf("%PDF-");
+    if(header < 0 || header > 1024) return false;
+
+    scanObjects();
+    loadObjectStreams();
+
+    // a classic trailer wins over cross reference streams, the last one belongs to the newest revision
+    for(int pos = data.lastIndexOf("trailer"); pos >= 0; pos = pos > 0 ? data.lastIndexOf("trailer", pos - 1) : -1)
+    {
+        int p = pos + 7;
+        auto dict = parseValue(data, p);
+        if(dict.type == Value::Type::Dictionary && dict.get("Root").type == Value::Type::Reference)
+        {
+            trailer = dict;
+            break;
+        }
+    }
+    if(trailer.get("Root").type != Value::Type::Reference) return false;
+
+    auto root = resolve(trailer.get("Root"));
+    QSet<int> visited;
+    collectPages(resolve(root.get("Pages")), {}, visited);
+    return !pages.isEmpty();
+}
+
+int PdfImageExtractor::pageCount() const
+{
+    return pages.size();
+}
+
+QByteArray PdfImageExtractor::pageJpeg(int pageNum) const
+{
+    if(pageNum < 0 || pageNum >= pages.size() || pages[pageNum].offset < 0) return {};
+    // a real copy, the caller may keep it longer than the mapping lives
+    return QByteArray(data.constData() + pages[pageNum].offset, int(pages[pageNum].length));
+}
+
+QSize PdfImageExtractor::pageImageSize(int pageNum) const
+{
+    if(pageNum < 0 || pageNum >= pages.size() || pages[pageNum].offset < 0) return {};
+    return pages[pageNum].size;
+}
+
+void PdfImageExtractor::skipSpace(const QByteArray& buf, int& pos)
+{
+    while(pos < buf.size())
+    {
+        if(buf[pos] == '%')
+        {
+            while(pos < buf.size() && buf[pos] != '\n' && buf[pos] != '\r') pos++;
+        }
+        else if(isSpace(buf[pos]))
+        {
+            pos++;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+PdfImageExtractor::Value PdfImageExtractor::parseValue(const QByteArray& buf, int& pos, int depth)
+{
+    Value v;
+    skipSpace(buf, pos);
+    if(pos >= buf.size() || depth > maxNesting) return v;
+
+    const char c = buf[pos];
+    if(c == '/')
+    {
+        const int start = ++pos;
+        while(pos < buf.size() && !isDelimiter(buf[pos])) pos++;
+        v.type = Value::Type::Name;
+        v.text = buf.mid(start, pos - start);
+    }
+    else if(c == '<' && pos + 1 < buf.size() && buf[pos + 1] == '<')
+    {
+        pos += 2;
+        v.type = Value::Type::Dictionary;
+        while(true)
+        {
+            skipSpace(buf, pos);
+            if(pos + 1 >= buf.size()) break;
+            if(buf[pos] == '>' && buf[pos + 1] == '>')
+            {
+                pos += 2;
+                break;
+            }
+            auto key = parseValue(buf, pos, depth + 1);
+            if(key.type != Value::Type::Name) break;
+            v.entries.append({key.text, parseValue(buf, pos, depth + 1)});
+        }
+    }
+    else if(c == '<')
+    {
+        const int end = buf.indexOf('>', pos);
+        v.type = Value::Type::String;
+        v.text = QByteArray::fromHex(buf.mid(pos + 1, end < 0 ? -1 : end - pos - 1));
+        pos = end < 0 ? buf.size() : end + 1;
+    }
+    else if(c == '[')
+    {
+        pos++;
+        v.type = Value::Type::Array;
+        while(true)
+        {
+            skipSpace(buf, pos);
+            if(pos >= buf.size()) break;
+            if(buf[pos] == ']')
+            {
+                pos++;
+                break;
+            }
+            const int before = pos;
+            v.items.append(parseValue(buf, pos, depth + 1));
+            if(pos == before) break;
+        }
+    }
+    else if(c == '(')
+    {
+        // only the extent matters here, escapes aren't decoded
+        const int start = ++pos;
+        int open = 1;
+        for(; pos < buf.size() && open > 0; pos++)
+        {
+            if(buf[pos] == '\\') pos++;
+            else if(buf[pos] == '(') open++;
+            else if(buf[pos] == ')') open--;
+        }
+        v.type = Value::Type::String;
+        v.text = buf.mid(start, pos - start - 1);
+    }
+    else if(isDigit(c) || c == '+' || c == '-' || c == '.')
+    {
+        const int start = pos++;
+        while(pos < buf.size() && !isDelimiter(buf[pos])) pos++;
+        v.type = Value::Type::Number;
+        v.number = buf.mid(start, pos - start).toDouble();
+
+        // "12 0 R" is a reference
+        int p = pos;
+        skipSpace(buf, p);
+        const int genStart = p;
+        while(p < buf.size() && isDigit(buf[p])) p++;
+        if(p > genStart && p < buf.size() && isSpace(buf[p]))
+        {
+            skipSpace(buf, p);
+            if(p < buf.size() && buf[p] == 'R' && (p + 1 == buf.size() || isDelimiter(buf[p + 1])))
+            {
+                v.type = Value::Type::Reference;
+                v.objNum = int(v.number);
+                pos = p + 1;
+            }
+        }
+    }
+    else if(isDelimiter(c))
+    {
+        // stray ) ] > { }, taken as an operator so the callers give up on it
+        pos++;
+        v.type = Value::Type::Operator;
+        v.text = QByteArray(1, c);
+    }
+    else
+    {
+        const int start = pos;
+        while(pos < buf.size() && !isDelimiter(buf[pos])) pos++;
+        v.text = buf.mid(start, pos - start);
+        if(v.text == "true" || v.text == "false")
+        {
+            v.type = Value::Type::Boolean;
+            v.number = v.text == "true";
+        }
+        else if(v.text != "null")
+        {
+            v.type = Value::Type::Operator;
+        }
+    }
+    return v;
+}
+
+void PdfImageExtractor::scanObjects()
+{
+    // objects are found by their "N G obj" header instead of trusting the cross reference table,
+    // later definitions (incremental updates) replace earlier ones
+    int pos = 0;
+    while(true)
+    {
+        const int i = data.indexOf("obj", pos);
+        if(i < 0) break;
+        pos = i + 3;
+        if(i == 0 || !isSpace(data[i - 1]) || (i + 3 < data.size() && !isDelimiter(data[i + 3]))) continue;
+
+        int p = i - 1;
+        while(p >= 0 && isSpace(data[p])) p--;
+        const int genEnd = p + 1;
+        while(p >= 0 && isDigit(data[p])) p--;
+        if(p + 1 == genEnd || p < 0 || !isSpace(data[p])) continue;
+        while(p >= 0 && isSpace(data[p])) p--;
+        const int numEnd = p + 1;
+        while(p >= 0 && isDigit(data[p])) p--;
+        if(p + 1 == numEnd || (p >= 0 && !isDelimiter(data[p]))) continue;
+
+        const int objNum = data.mid(p + 1, numEnd - p - 1).toInt();
+        locations[objNum] = {-1, i + 3};
+
+        // jump over stream data, bytes inside an image must not be taken for objects
+        int vp = i + 3;
+        const auto v = parseValue(data, vp);
+        if(v.get("Type").isName("ObjStm")) objectStreamNums.append(objNum);
+        // files without a classic trailer keep its entries in the cross reference stream
+        if(v.get("Type").isName("XRef") && v.get("Root").type == Value::Type::Reference) trailer = v;
+        skipSpace(data, vp);
+        if(data.mid(vp, 6) == "stream")
+        {
+            const auto length = v.get("Length");
+            if(length.type == Value::Type::Number && vp + 6 + qint64(length.number) <= data.size())
+            {
+                vp += 6 + int(length.number);
+            }
+            else if(const int end = data.indexOf("endstream", vp); end >= 0)
+            {
+                vp = end;
+            }
+        }
+        pos = std::max(pos, vp);
+    }
+}
+
+void PdfImageExtractor::loadObjectStreams()
+{
+    for(int streamNum: std::as_const(objectStreamNums))
+    {
+        Value dict;
+        qint64 offset = 0, length = 0;
+        if(!streamOf(streamNum, dict, offset, length)) continue;
+        const QByteArray decoded = decodedStream(streamNum);
+        if(decoded.isEmpty()) continue;
+        objectStreams.insert(streamNum, decoded);
+
+        // the stream starts with pairs of object number and offset relative to /First
+        const int count = int(resolve(dict.get("N")).number);
+        const int first = int(resolve(dict.get("First")).number);
+        int pos = 0;
+        for(int i = 0; i < count; i++)
+        {
+            const auto num = parseValue(decoded, pos);
+            const auto off = parseValue(decoded, pos);
+            if(num.type != Value::Type::Number || off.type != Value::Type::Number) break;
+            if(!locations.contains(int(num.number))) locations.insert(int(num.number), {streamNum, first + int(off.number)});
+        }
+    }
+}
+
+PdfImageExtractor::Value PdfImageExtractor::object(int objNum) const
+{
+    if(!locations.contains(objNum)) return {};
+    const Location loc = locations.value(objNum);
+    int pos = loc.offset;
+    if(loc.streamObjNum < 0) return parseValue(data, pos);
+    const QByteArray buf = objectStreams.value(loc.streamObjNum);
+    return parseValue(buf, pos);
+}
+
+PdfImageExtractor::Value PdfImageExtractor::resolve(const Value& v) const
+{
+    Value res = v;
+    for(int i = 0; i < maxReferenceHops && res.type == Value::Type::Reference; i++) res = object(res.objNum);
+    return res.type == Value::Type::Reference ? Value{} : res;
+}
+
+bool PdfImageExtractor::streamOf(int objNum, Value& dict, qint64& offset, qint64& length) const
+{
+    // streams never live inside object streams
+    if(!locations.contains(objNum) || locations.value(objNum).streamObjNum >= 0) return false;
+    int pos = locations.value(objNum).offset;
+    dict = parseValue(data, pos);
+    if(dict.type != Value::Type::Dictionary) return false;
+    skipSpace(data, pos);
+    if(data.mid(pos, 6) != "stream") return false;
+    pos += 6;
+    if(pos < data.size() && data[pos] == '\r') pos++;
+    if(pos < data.size() && data[pos] == '\n') pos++;
+
+    const auto len = resolve(dict.get("Length"));
+    if(len.type != Value::Type::Number || len.number < 0 || pos + qint64(len.number) > data.size()) return false;
+    offset = pos;
+    length = qint64(len.number);
+    return true;
+}
+
+QByteArray PdfImageExtractor::decodedStream(int objNum) const
+{
+    Value dict;
+    qint64 offset = 0, length = 0;
+    if(!streamOf(objNum, dict, offset, length)) return {};
+    const QByteArray raw = QByteArray::fromRawData(data.constData() + offset, int(length));
+
+    auto filter = resolve(dict.get("Filter"));
+    if(filter.type == Value::Type::Array && filter.items.size() == 1) filter = resolve(filter.items.first());
+    if(filter.type == Value::Type::Null) return QByteArray(raw.constData(), raw.size());
+    // predictors only show up in cross reference streams and images, which aren't needed decoded
+    const auto params = resolve(dict.get("DecodeParms"));
+    if(!filter.isName("FlateDecode") || resolve(params.get("Predictor")).number > 1) return {};
+    return inflate(raw);
+}
+
+void PdfImageExtractor::collectPages(const Value& node, Inherited inherited, QSet<int>& visited)
+{
+    if(node.type != Value::Type::Dictionary) return;
+    if(auto v = node.get("Resources"); v.type != Value::Type::Null) inherited.resources = v;
+    if(auto v = node.get("MediaBox"); v.type != Value::Type::Null) inherited.mediaBox = v;
+    if(auto v = node.get("CropBox"); v.type != Value::Type::Null) inherited.cropBox = v;
+    if(auto v = node.get("Rotate"); v.type != Value::Type::Null) inherited.rotate = int(resolve(v).number);
+
+    const auto kids = resolve(node.get("Kids"));
+    if(node.get("Type").isName("Pages") || kids.type == Value::Type::Array)
+    {
+        for(const auto& kid: kids.items)
+        {
+            // a broken tree could point back to its own ancestors
+            if(kid.type != Value::Type::Reference || visited.contains(kid.objNum)) continue;
+            visited.insert(kid.objNum);
+            collectPages(resolve(kid), inherited, visited);
+        }
+        return;
+    }
+    pages.append(examinePage(node, inherited));
+}
+
+PdfImageExtractor::PageImage PdfImageExtractor::examinePage(const Value& page, const Inherited& inherited) const
+{
+    if(inherited.rotate % 360 != 0) return {};
+
+    // the area Poppler renders
+    const auto box = resolve(inherited.cropBox.type != Value::Type::Null ? inherited.cropBox : inherited.mediaBox);
+    if(box.type != Value::Type::Array || box.items.size() != 4) return {};
+    double coords[4];
+    for(int i = 0; i < 4; i++) coords[i] = resolve(box.items[i]).number;
+    const double x0 = std::min(coords[0], coords[2]), x1 = std::max(coords[0], coords[2]);
+    const double y0 = std::min(coords[1], coords[3]), y1 = std::max(coords[1], coords[3]);
+
+    QByteArray content;
+    const auto contents = resolve(page.get("Contents"));
+    const QList<Value> parts = contents.type == Value::Type::Array ? contents.items : QList<Value>{page.get("Contents")};
+    for(const auto& part: parts)
+    {
+        if(part.type != Value::Type::Reference) return {};
+        const QByteArray decoded = decodedStream(part.objNum);
+        if(decoded.isEmpty()) return {};
+        content += decoded + '\n';
+    }
+
+    // nothing but placing one image: q, cm, Do, Q
+    QList<Value> operands;
+    QVector<Matrix> stack;
+    Matrix ctm, imageMatrix;
+    QByteArray imageName;
+    int pos = 0;
+    while(true)
+    {
+        skipSpace(content, pos);
+        if(pos >= content.size()) break;
+        const auto v = parseValue(content, pos);
+        if(v.type != Value::Type::Operator)
+        {
+            if(v.type != Value::Type::Number && v.type != Value::Type::Name) return {};
+            operands.append(v);
+            continue;
+        }
+        if(v.text == "q")
+        {
+            stack.append(ctm);
+        }
+        else if(v.text == "Q")
+        {
+            if(stack.isEmpty()) return {};
+            ctm = stack.takeLast();
+        }
+        else if(v.text == "cm" && operands.size() == 6)
+        {
+            const Matrix m{operands[0].number, operands[1].number, operands[2].number, operands[3].number, operands[4].number, operands[5].number};
+            ctm = m.then(ctm);
+        }
+        else if(v.text == "Do" && operands.size() == 1 && operands[0].type == Value::Type::Name && imageName.isEmpty())
+        {
+            imageName = operands[0].text;
+            imageMatrix = ctm;
+        }
+        else
+        {
+            return {};
+        }
+        operands.clear();
+    }
+    if(imageName.isEmpty() || !operands.isEmpty()) return {};
+
+    // the unit square the image is drawn into has to cover the page box, upright and unmirrored
+    const double tolerance = std::max(1.0, 0.005 * std::max(x1 - x0, y1 - y0));
+    const auto& m = imageMatrix;
+    if(std::abs(m.b) > 1e-6 || std::abs(m.c) > 1e-6 || m.a <= 0 || m.d <= 0) return {};
+    if(std::abs(m.e - x0) > tolerance || std::abs(m.f - y0) > tolerance
+       || std::abs(m.e + m.a - x1) > tolerance || std::abs(m.f + m.d - y1) > tolerance) return {};
+
+    const auto xobjects = resolve(resolve(inherited.resources).get("XObject"));
+    const auto ref = xobjects.get(imageName);
+    if(ref.type != Value::Type::Reference) return {};
+    Value dict;
+    qint64 offset = 0, length = 0;
+    if(!streamOf(ref.objNum, dict, offset, length)) return {};
+
+    if(!dict.get("Subtype").isName("Image") || resolve(dict.get("ImageMask")).number != 0) return {};
+    if(dict.get("SMask").type != Value::Type::Null || dict.get("Mask").type != Value::Type::Null || dict.get("Decode").type != Value::Type::Null) return {};
+    if(resolve(dict.get("BitsPerComponent")).number != 8) return {};
+    auto filter = resolve(dict.get("Filter"));
+    if(filter.type == Value::Type::Array && filter.items.size() == 1) filter = resolve(filter.items.first());
+    if(!filter.isName("DCTDecode")) return {};
+
+    // CMYK JPEGs are stored inverted by some writers and indexed images need the palette, leave them to the renderer
+    const auto colorSpace = resolve(dict.get("ColorSpace"));
+    bool plainColorSpace = colorSpace.isName("DeviceRGB") || colorSpace.isName("DeviceGray");
+    if(colorSpace.type == Value::Type::Array && colorSpace.items.size() == 2 && colorSpace.items[0].isName("ICCBased")
+       && colorSpace.items[1].type == Value::Type::Reference)
+    {
+        Value profile;
+        qint64 profileOffset = 0, profileLength = 0;
+        if(streamOf(colorSpace.items[1].objNum, profile, profileOffset, profileLength))
+        {
+            const int components = int(resolve(profile.get("N")).number);
+            plainColorSpace = components == 1 || components == 3;
+        }
+    }
+    if(!plainColorSpace) return {};
+
+    if(length < 4 || uchar(data[int(offset)]) != 0xFF || uchar(data[int(offset) + 1]) != 0xD8) return {};
+
+    PageImage res;
+    res.offset = offset;
+    res.length = length;
+    res.size = QSize(int(resolve(dict.get("Width")).number), int(resolve(dict.get("Height")).number));
+    return res;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSet>
+#include <QSize>
+#include <QVector>
+
+/**
+ * Finds the pages of a PDF that are nothing but one full page JPEG, as scanned comics usually are,
+ * so they can be decoded from the embedded DCT stream at native resolution instead of being rendered.
+ * This is a minimal reader of the file structure: objects are located by scanning the file
+ * (including compressed object streams), the page tree is walked from the trailer's /Root.
+ * A page qualifies if its content only places a single /DCTDecode image over the whole page box
+ * (q, cm, Do and Q operators), in an RGB or gray color space without masks or decode arrays.
+ * Anything else is left to the renderer.
+ */
+class PdfImageExtractor
+{
+public:
+    // maps the file and examines all pages, returns false if it isn't a PDF this reader understands
+    bool open(const QString& path);
+    // same for a file already in memory, data has to stay valid while the extractor is used
+    bool parse(const QByteArray& data);
+    int pageCount() const;
+    // the JPEG file of a single image page, empty for pages that need rendering
+    QByteArray pageJpeg(int pageNum) const;
+    // pixel size of the image of a single image page, invalid for other pages
+    QSize pageImageSize(int pageNum) const;
+
+private:
+    struct Value
+    {
+        enum class Type
+        {
+            Null,
+            Boolean,
+            Number,
+            Name,
+            String,
+            Array,
+            Dictionary,
+            Reference,
+            Operator
+        };
+        Type type = Type::Null;
+        double number = 0;
+        int objNum = 0;
+        // name without the slash, operator keyword or raw string bytes
+        QByteArray text;
+        QList<Value> items;
+        QList<QPair<QByteArray, Value>> entries;
+        Value get(const QByteArray& key) const;
+        bool isName(const char* name) const;
+    };
+    struct Location
+    {
+        // -1: in the file itself, otherwise the number of the object stream holding the object
+        int streamObjNum = -1;
+        int offset = 0;
+    };
+    struct PageImage
+    {
+        qint64 offset = -1;
+        qint64 length = 0;
+        QSize size;
+    };
+    struct Inherited
+    {
+        Value resources;
+        Value mediaBox;
+        Value cropBox;
+        int rotate = 0;
+    };
+
+    static void skipSpace(const QByteArray& buf, int& pos);
+    static Value parseValue(const QByteArray& buf, int& pos, int depth = 0);
+    void scanObjects();
+    void loadObjectStreams();
+    Value object(int objNum) const;
+    Value resolve(const Value& v) const;
+    // the dictionary and the data position of a stream object
+    bool streamOf(int objNum, Value& dict, qint64& offset, qint64& length) const;
+    QByteArray decodedStream(int objNum) const;
+    void collectPages(const Value& node, Inherited inherited, QSet<int>& visited);
+    PageImage examinePage(const Value& page, const Inherited& inherited) const;
+
+    QFile file;
+    QByteArray data;
+    QHash<int, Location> locations;
+    QHash<int, QByteArray> objectStreams;
+    QList<int> objectStreamNums;
+    Value trailer;
+    QVector<PageImage> pages;
+};
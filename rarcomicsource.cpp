@@ -1,12 +1,16 @@
 #include "rarcomicsource.h"
 #include "imagecache.h"
+#include "encodedcache.h"
+#include "grayscale.h"
+#include "imagebufferpool.h"
+#include "diskpagecache.h"
+#include "comicinfo.h"
 
-#include <QCollator>
 #include <QCryptographicHash>
 #include <QDir>
 #include <QEventLoop>
+#include <QFileInfo>
 #include <QMimeData>
-#include <QMimeDatabase>
 #include <QObject>
 #include <QProcess>
 #include <QTemporaryFile>
@@ -18,6 +22,7 @@ RarComicSource::RarComicSource(const QString& path)
             :FileComicSource(path)
 {
     signatureMimeStr = "application/rar";
+    fileVersion = QFileInfo(this->path).lastModified().toSecsSinceEpoch();
     //rar vt, list file info.
 
     // QObject::connect(&proc, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), [=](int exitCode, QProcess::ExitStatus status){ });
@@ -34,7 +39,8 @@ RarComicSource::RarComicSource(const QString& path)
 
     bool isList{false};
     bool isImg{false};
-    PageMetadata cur;
+    QString comicInfoName;
+    QString fileName;
     for (auto s: text.split("\n")){
         auto l = s.trimmed();
         if(l.startsWith("Details")){
@@ -48,37 +54,46 @@ RarComicSource::RarComicSource(const QString& path)
             if (l.startsWith(fnPattern)){
                 auto fn = l.mid(fnPattern.size());
                 isImg = isImage(fn);
-                cur.fileName = fn;
+                fileName = fn;
+                if(fn.compare(ComicInfo::fileName, Qt::CaseInsensitive) == 0)
+                    comicInfoName = fn;
             }
             if (l.startsWith(sizePattern)){
                 auto size = l.mid(sizePattern.size());
-                cur.fileSize = size.toInt();
-                cur.width = -1;
-                cur.height = -1;
                 if(isImg)
-                    m_rarFileInfoList.push_back(cur);
+                    this->pages.append(fileName, size.toLongLong());
             }
-            //sort
         }
     }
-    // auto len = m_rarFileInfoList.size();
-    // for(auto i = 0; i< len; i++){
-    //     auto cur = m_rarFileInfoList[i];
-    // }
-    QCollator collator;
-    collator.setNumericMode(true);
-
-    std::sort(
-      this->m_rarFileInfoList.begin(), this->m_rarFileInfoList.end(),
-      [&collator](const PageMetadata& file1, const PageMetadata& file2) {
-          return collator.compare(file1.fileName, file2.fileName) < 0;
-      });
+    this->pages.sortByName();
+    if(!comicInfoName.isEmpty())
+        readComicInfo(comicInfoName);
+}
+
+void RarComicSource::readComicInfo(const QString& entryName)
+{
+    QEventLoop evlp;
+    QProcess proc;
+    proc.start("unrar", {"p", "-inul", "-@", "--", this->path, entryName});
+    QObject::connect(&proc, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                     &evlp, &QEventLoop::quit);
+    evlp.exec();
+
+    const auto table = ComicInfo::pageTable(proc.readAllStandardOutput(), getPageCount());
+    for(auto it = table.cbegin(); it != table.cend(); ++it)
+    {
+        // a size that doesn't match means the page was replaced after tagging
+        if(it->fileSize > 0 && it->fileSize != this->pages.fileSize(it.key())) continue;
+        this->pages.setImageSize(it.key(), QSize(it->width, it->height));
+        this->pages.setBigPage(it.key(), it->isBigPage);
+        if(!it->tags.isEmpty()) this->pages.setPageType(it.key(), it->tags.first());
+    }
 }
 
 RarComicSource::~RarComicSource() {}
 
 int RarComicSource::getPageCount() const {
-    return m_rarFileInfoList.count();
+    return this->pages.size();
 }
 
 QPixmap RarComicSource::getPagePixmap(int pageNum) {
@@ -87,23 +102,45 @@ QPixmap RarComicSource::getPagePixmap(int pageNum) {
     if(auto img = ImageCache::cache().getImage(cacheKey); !img.isNull())
         return img;
 
-    QString imageFileName = this->m_rarFileInfoList[pageNum].fileName;
-    QEventLoop evlp;
-    QProcess proc;
-    proc.start("unrar", {"p", "-inul", "-@", "--", this->path,imageFileName});
-    QObject::connect(&proc, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-                     &evlp, &QEventLoop::quit);
-    evlp.exec();
+    // decoded pages from an earlier session skip unrar entirely
+    const QString diskCacheParams = QStringLiteral("rar/%1/%2/%3").arg(this->pages.name(pageNum)).arg(this->pages.fileSize(pageNum)).arg(fileVersion);
+    if(auto decoded = DiskPageCache::cache().getImage(id, pageNum, diskCacheParams); !decoded.isNull())
+    {
+        auto img = Grayscale::toPixmap(decoded);
+        ImageCache::cache().addImage(cacheKey, img);
+        return img;
+    }
+
+    // spawning unrar costs far more than decoding, keep the extracted file around
+    auto out = EncodedCache::cache().get(cacheKey);
+    if(out.isEmpty())
+    {
+        QString imageFileName = this->pages.name(pageNum);
+        QEventLoop evlp;
+        QProcess proc;
+        proc.start("unrar", {"p", "-inul", "-@", "--", this->path,imageFileName});
+        QObject::connect(&proc, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                         &evlp, &QEventLoop::quit);
+        evlp.exec();
 
-    auto res = proc.waitForFinished();
-    auto out = proc.readAllStandardOutput();
-    QPixmap img;
-    img.loadFromData(out);
+        auto res = proc.waitForFinished();
+        out = proc.readAllStandardOutput();
+        if(!out.isEmpty()) EncodedCache::cache().add(cacheKey, out);
+    }
+    auto decoded = Grayscale::compacted(ImageBufferPool::pool().decode(out));
+    DiskPageCache::cache().addImage(id, pageNum, diskCacheParams, decoded);
+    auto img = Grayscale::toPixmap(decoded);
     ImageCache::cache().addImage(cacheKey, img);
     return img;
     return {};
 }
 
+QSize RarComicSource::getPageSize(int pageNum)
+{
+    if(auto size = ComicSource::getPageSize(pageNum); size.isValid()) return size;
+    return this->pages.imageSize(pageNum);
+}
+
 QString RarComicSource::getPageFilePath(int pageNum) {
     //extract file.
     QTemporaryFile tmp;
@@ -111,7 +148,7 @@ QString RarComicSource::getPageFilePath(int pageNum) {
     if(tmp.open())
     {
         QPixmap img;
-        QString imageFileName = this->getPageMetadata(pageNum).fileName;
+        QString imageFileName = this->pages.name(pageNum);
         QEventLoop evlp;
         QProcess proc;
         proc.start("unrar", {"p", "-inul", "-@", "--", this->path,imageFileName});
@@ -127,31 +164,14 @@ QString RarComicSource::getPageFilePath(int pageNum) {
 }
 
 PageMetadata RarComicSource::getPageMetadata(int pageNum) {
-    auto incache = [this](int page) -> bool{
-        auto&& data = this->m_rarFileInfoList.at(page);
-        if(data.width == -1 && data.height == -1)
-            return false;
-        return true;
-    };
     assert(pageNum >= 0 &&
-           pageNum < this->m_rarFileInfoList.count()
+           pageNum < this->pages.size()
            );
-    auto& res = m_rarFileInfoList[pageNum];
-    if(res.width != -1 && res.height != -1)
-        return res;
-
-    auto px = getPagePixmap(pageNum);
-    res.width = px.width();
-    res.height = px.height();
-    QMimeDatabase mdb;
-    auto possibleMimes = mdb.mimeTypesForFileName(res.fileName);
-    if(!possibleMimes.empty()) {
-        res.fileType = possibleMimes[0].name();
-    } else {
-        res.fileType = "unknown";
+    if(!this->pages.imageSize(pageNum).isValid())
+    {
+        auto px = getPagePixmap(pageNum);
+        this->pages.setImageSize(pageNum, px.size());
     }
-
-    res.valid = true;
-    return res;
+    return this->pages.metadata(pageNum);
 }
 
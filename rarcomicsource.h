@@ -9,8 +9,13 @@ public:
     virtual QPixmap getPagePixmap(int pageNum) override;
     virtual QString getPageFilePath(int pageNum) override;
     virtual PageMetadata getPageMetadata(int pageNum) override;
+    virtual QSize getPageSize(int pageNum) override;
     virtual ~RarComicSource();
 
 protected:
-    QList<PageMetadata> m_rarFileInfoList;
+    // takes the page sizes from the page table of ComicInfo.xml, entryName is its name as listed in the archive
+    void readComicInfo(const QString& entryName);
+    PageTable pages;
+    // modification time of the archive, decoded pages on disk are only valid for this version of it
+    qint64 fileVersion = 0;
 };
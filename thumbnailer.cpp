@@ -20,6 +20,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "comicsource.h"
 #include "imagecache.h"
 #include "imagepreloader.h"
+#include "imagescaler.h"
 #include <QDir>
 #include <QStandardPaths>
 #include <QMutexLocker>
@@ -161,7 +162,7 @@ void Thumbnailer::refocus(int pageNum)
 
 QPixmap Thumbnailer::createThumb(int page)
 {
-    return m_comicSource->getPagePixmap(page).scaled(c_cellSizeX, c_cellSizeY, Qt::KeepAspectRatio, m_fastScaling ? Qt::FastTransformation : Qt::SmoothTransformation);
+    return ImageScaler::scaled(m_comicSource->getPagePixmapForSize(page, {c_cellSizeX, c_cellSizeY}), c_cellSizeX, c_cellSizeY, Qt::KeepAspectRatio, m_fastScaling ? Qt::FastTransformation : Qt::SmoothTransformation);
 }
 
 int Thumbnailer::checkQueue()
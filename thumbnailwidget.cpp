@@ -89,14 +89,7 @@ bool ThumbnailWidget::pageNumbersShown() const
 void ThumbnailWidget::setComicSource(ComicSource* src)
 {
     this->comic = src;
-    if(src)
-    {
-        pageNumSize = QFontMetrics(font()).boundingRect(QString::number(src->getPageCount())).width() + 4;
-    }
-    else
-    {
-        pageNumSize = QFontMetrics(font()).boundingRect("999").width() + 4;
-    }
+    updatePageNumSize();
     currentX = 0;
     currentY = 0;
     this->setCurrentPage(0);
@@ -191,7 +184,14 @@ void ThumbnailWidget::paintEvent(QPaintEvent* event)
 
             if(currentPage > 0 && !dynamicBackground.isValid() && thumbBkg == "dynamic")
             {
-                if(auto img = ThumbCache::cache().getPixmap({comic->getID(), currentPage}); !img.isNull())
+                // ThumbCache keys are 0-based, currentPage is 1-based
+                if(auto edgeColors = ImageCache::cache().getEdgeColors({comic->getID(), currentPage - 1}); !edgeColors.isEmpty())
+                {
+                    dynamicBackground = EdgeColorHistogram::mostCommonColor(edgeColors, {});
+                    painter.fillRect(painter.viewport(), dynamicBackground);
+                    finalBkg = dynamicBackground;
+                }
+                else if(auto img = ThumbCache::cache().getPixmap({comic->getID(), currentPage - 1}); !img.isNull())
                 {
                     dynamicBackground = MainWindow::getMostCommonEdgeColor(img.toImage(), {});
                     painter.fillRect(painter.viewport(), dynamicBackground);
@@ -282,6 +282,31 @@ void ThumbnailWidget::ensureDisplacementWithinAllowedBounds()
     emit this->updateVerticalScrollBar(allowedYDisplacement, currentY, this->height(), getThumbCellHeight());
 }
 
+void ThumbnailWidget::pageCountChanged()
+{
+    const int oldWidth = this->getThumbCellWidth();
+    updatePageNumSize();
+    this->updateAllowedDisplacement();
+    if(automaticFixedWidth && this->getThumbCellWidth() != oldWidth)
+    {
+        this->setMinimumWidth(this->getThumbCellWidth());
+        emit automaticallyResizedSelf(this->width());
+    }
+    update();
+}
+
+void ThumbnailWidget::updatePageNumSize()
+{
+    if(comic)
+    {
+        pageNumSize = QFontMetrics(font()).boundingRect(QString::number(comic->getPageCount())).width() + 4;
+    }
+    else
+    {
+        pageNumSize = QFontMetrics(font()).boundingRect("999").width() + 4;
+    }
+}
+
 void ThumbnailWidget::updateAllowedDisplacement()
 {
     if(comic)
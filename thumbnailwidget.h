@@ -48,6 +48,8 @@ public slots:
     void setVerticalScrollPosition(int pos);
     void setCurrentPage(int page);
     void setComicSource(ComicSource* src);
+    // the source got pages at its end or lost some there, unlike setComicSource the view stays where it is
+    void pageCountChanged();
     void notifyPageThumbnailAvailable(const QString& srcID, int page);
     void setShowPageNumbers(bool show);
     void setThumbnailBackground(const QString& bkg);
@@ -61,6 +63,7 @@ protected:
 private:
     void ensureDisplacementWithinAllowedBounds();
     void updateAllowedDisplacement();
+    void updatePageNumSize();
     void ensurePageVisible(int page);
     bool showPageNums = false;
     bool automaticFixedWidth = false;